@@ -1,55 +1,800 @@
+#define _GNU_SOURCE             // cpu_set_t / pthread_attr_setaffinity_np
 #include <stdio.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <time.h>
 
-#define THREAD_POOL_SIZE 4
+#define THREAD_POOL_SIZE 4      // 无法获取在线 CPU 数时的默认线程数
+#define MAX_CPUS 1024
 #define TASK_QUEUE_SIZE 10
+#define CACHE_LINE 64
+#define DEQUE_CAPACITY 4096     // 每个工作线程本地双端队列容量（必须是 2 的幂）
+#define INJECT_BATCH 32         // 窃取模式下从全局队列一次搬运到本地队列的任务数
+#define TASK_SLAB_SIZE 256      // 每次向堆申请的任务节点个数
+#define LOCAL_FREE_MAX 256      // 工作线程本地空闲节点缓存上限
+#define FREE_BATCH 128          // 本地缓存与全局空闲链表之间一次转移的节点数
+#define IDLE_SPIN_DEFAULT 1000  // 空闲时先自旋的次数
+#define IDLE_YIELD_DEFAULT 8    // 自旋后 sched_yield 的次数，之后才休眠
+#define STARVATION_MS_DEFAULT 50    // 低优先级任务等待超过该时长即视为饥饿
+#define STARVATION_SHARE 8      // 每 8 次调度至少留 1 次给饥饿任务
+#define WAIT_HIST_BUCKETS 256   // 等待时间直方图：log2 分桶，每桶再细分 4 档
+
+typedef enum {
+    POOL_MODE_GLOBAL,           // 单一全局队列，一把锁
+    POOL_MODE_STEALING          // 每线程双端队列 + 工作窃取
+} pool_mode_t;
+
+typedef enum {
+    PIN_NONE,                   // 不绑核，由内核调度
+    PIN_LIST,                   // 按 cpulist 给出的顺序依次绑定
+    PIN_COMPACT,                // 按 sysfs 拓扑紧凑放置：先填满一个 NUMA 节点的物理核，再用超线程，再换节点
+    PIN_SCATTER                 // 按 sysfs 拓扑分散放置：各 NUMA 节点轮流分配
+} pin_policy_t;
+
+typedef enum {
+    PRIO_HIGH,                  // 延迟敏感的请求
+    PRIO_NORMAL,
+    PRIO_LOW,                   // 批量任务
+    PRIO_LEVELS
+} task_priority_t;
+
+typedef enum {
+    SHUTDOWN_DRAIN,             // 执行完所有已提交的任务再退出
+    SHUTDOWN_DISCARD            // 丢弃尚未开始的任务，相关闭锁计为取消
+} shutdown_mode_t;
+
+// 倒计时闭锁：计数归零前 wait 阻塞；只有最后一次 count_down 才需要加锁唤醒
+typedef struct {
+    int count;
+    int cancelled;              // 因关闭线程池而未执行的任务数
+    int done;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} task_latch_t;
+
+// 带返回值的任务句柄
+typedef struct {
+    void *(*function)(void *);
+    void *arg;
+    void *result;
+    task_latch_t latch;
+} task_future_t;
 
 typedef struct task {
     void (*function)(void *);
     void *arg;
+    task_latch_t *latch;        // 任务完成（或被取消）时递减，可为 NULL
+    int priority;
+    unsigned long enqueue_ns;   // 进入全局队列的时刻
+    unsigned long deadline_ns;  // 绝对截止时间，0 表示没有截止时间
     struct task *next;
 } task_t;
 
+// 提交选项；NULL 等价于 {PRIO_NORMAL, 0}
+typedef struct {
+    task_priority_t priority;
+    unsigned long deadline_us;  // 相对提交时刻的截止时间，0 表示没有截止时间
+} task_opts_t;
+
+// 每个优先级的队列统计，等待时间指从进入全局队列到被工作线程取走
+typedef struct {
+    unsigned long enqueued;
+    unsigned long dequeued;
+    int depth;
+    int max_depth;
+    unsigned long aged;             // 因防饿死机制被提前调度的次数
+    unsigned long deadline_missed;  // 取出时已超过截止时间的任务数
+    unsigned long wait_total_ns;
+    unsigned long wait_max_ns;
+    unsigned long wait_hist[WAIT_HIST_BUCKETS];
+} prio_stats_t;
+
+// 任务节点按 slab 批量分配，线程池销毁时统一释放
+typedef struct task_slab {
+    struct task_slab *next;
+    task_t tasks[TASK_SLAB_SIZE];
+} task_slab_t;
+
 typedef struct {
-    pthread_t threads[THREAD_POOL_SIZE];
-    task_t *task_queue;
-    int task_count;
+    int thread_count;           // 0 表示使用在线 CPU 数
+    pool_mode_t mode;
+    int max_queued;             // 全局队列长度上限，超过时提交方阻塞；0 表示不限制
+    pin_policy_t pin;
+    const char *cpulist;        // 允许使用的 CPU，如 "0-7,16-23"；NULL 表示进程可用的全部 CPU
+    int spin_iterations;        // 空闲策略：先带 pause 指令自旋 N 次
+    int yield_iterations;       // 再 sched_yield M 次，仍无任务才在条件变量上休眠
+    int starvation_ms;          // 防饿死阈值，0 表示严格按优先级调度
+} thread_pool_config_t;
+
+typedef struct {
+    int cpu;
+    int node;
+    int package;
+    int core;
+    int smt;                    // 在同一物理核中的超线程序号
+} cpu_info_t;
+
+// Chase-Lev 双端队列：所有者在 bottom 端 LIFO 压入/弹出，窃取者在 top 端 FIFO 窃取
+typedef struct {
+    long top __attribute__((aligned(CACHE_LINE)));
+    long bottom __attribute__((aligned(CACHE_LINE)));
+    task_t *buffer[DEQUE_CAPACITY] __attribute__((aligned(CACHE_LINE)));
+} ws_deque_t;
+
+struct thread_pool;
+
+typedef struct {
+    ws_deque_t deque;
+    struct thread_pool *pool;
+    int id;
+    int cpu;                    // 绑定的 CPU，-1 表示未绑定
+    int node;                   // 所在 NUMA 节点，-1 表示未知
+    unsigned int seed;          // 随机选择窃取目标
+    unsigned long steals;       // 成功窃取次数
+    unsigned long completed;    // 已执行的任务数
+    unsigned long wakeups_avoided;  // 本线程提交时因无人休眠而省掉的唤醒
+    task_t *free_list;          // 本地空闲节点缓存，只有所有者访问
+    int free_count;
+} worker_t;
+
+typedef struct thread_pool {
+    pool_mode_t mode;
+    int thread_count;
+    pthread_t *threads;
+    worker_t *workers;
+    task_t *queue_head[PRIO_LEVELS];    // 每个优先级一个 FIFO
+    task_t *queue_tail[PRIO_LEVELS];
+    task_t **deadline_heap;     // 带截止时间的任务按（优先级, 截止时间）组成小顶堆，同级内 EDF
+    int heap_size;
+    int heap_capacity;
+    int task_count;             // 全局队列中的任务总数
+    int urgent_count;           // 其中高优先级和带截止时间的任务数
+    unsigned long starvation_ns;
+    int since_aged;             // 距上次调度饥饿任务已过的调度次数
+    prio_stats_t stats[PRIO_LEVELS];
+    int max_queued;
     pthread_mutex_t mutex;
     pthread_cond_t cond;
+    pthread_cond_t not_full;
+    int full_waiters;           // 因队列满而阻塞的提交方数量
+    int idle_count;             // 正在 cond_wait 的线程数，提交方只在它大于 0 时才唤醒
+    int spin_iterations;
+    int yield_iterations;
+    unsigned long parks;        // 工作线程进入休眠的次数
+    unsigned long wakeups;      // 发出的唤醒次数
+    unsigned long wakeups_avoided;  // 提交时无人休眠而省掉的唤醒（受 mutex 保护）
     int shutdown;
+    int drain;                  // 关闭时是否先执行完剩余任务
+    task_t *free_list;          // 全局空闲节点链表，受 mutex 保护
+    task_slab_t *slabs;
+    unsigned long alloc_calls;  // 向堆申请内存的次数
 } thread_pool_t;
 
 thread_pool_t pool;
 
-void *worker(void *arg) {
-    (void)arg;
+// 当前线程所属的工作线程（非工作线程为 NULL）
+static __thread worker_t *current_worker;
+
+static unsigned long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+void latch_init(task_latch_t *latch, int count) {
+    latch->count = count;
+    latch->cancelled = 0;
+    latch->done = count <= 0;
+    pthread_mutex_init(&latch->mutex, NULL);
+    pthread_cond_init(&latch->cond, NULL);
+}
+
+void latch_count_down(task_latch_t *latch) {
+    if (__atomic_sub_fetch(&latch->count, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+
+    // done 只在锁内置位，保证等待方返回并销毁闭锁时这里已经不再访问它
+    pthread_mutex_lock(&latch->mutex);
+    latch->done = 1;
+    pthread_cond_broadcast(&latch->cond);
+    pthread_mutex_unlock(&latch->mutex);
+}
+
+void latch_wait(task_latch_t *latch) {
+    pthread_mutex_lock(&latch->mutex);
+    while (!latch->done) {
+        pthread_cond_wait(&latch->cond, &latch->mutex);
+    }
+    pthread_mutex_unlock(&latch->mutex);
+}
+
+void latch_destroy(task_latch_t *latch) {
+    pthread_mutex_destroy(&latch->mutex);
+    pthread_cond_destroy(&latch->cond);
+}
+
+static inline void deque_init(ws_deque_t *d) {
+    d->top = 0;
+    d->bottom = 0;
+}
+
+// 仅所有者调用；队列满时返回 -1
+static int deque_push(ws_deque_t *d, task_t *task) {
+    long b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+    long t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+
+    if (b - t >= DEQUE_CAPACITY) {
+        return -1;
+    }
+
+    __atomic_store_n(&d->buffer[b & (DEQUE_CAPACITY - 1)], task, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// 仅所有者调用，从 bottom 端取最新压入的任务
+static task_t *deque_pop(ws_deque_t *d) {
+    long b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        // 队列为空，恢复 bottom
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    task_t *task = __atomic_load_n(&d->buffer[b & (DEQUE_CAPACITY - 1)], __ATOMIC_RELAXED);
+    if (t == b) {
+        // 只剩最后一个任务，与窃取者竞争
+        if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            task = NULL;
+        }
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+// 任意线程调用，从 top 端取最早压入的任务；竞争失败返回 NULL
+static task_t *deque_steal(ws_deque_t *d) {
+    long t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+
+    if (t >= b) {
+        return NULL;
+    }
+
+    task_t *task = __atomic_load_n(&d->buffer[t & (DEQUE_CAPACITY - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    return task;
+}
+
+static inline int deque_size(ws_deque_t *d) {
+    long b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+    long t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    return b > t ? (int)(b - t) : 0;
+}
+
+// 调用者需持有 pool->mutex
+static void slab_grow(thread_pool_t *p) {
+    task_slab_t *slab = malloc(sizeof(task_slab_t));
+    if (slab == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    p->alloc_calls++;
+
+    slab->next = p->slabs;
+    p->slabs = slab;
+    for (int i = 0; i < TASK_SLAB_SIZE; i++) {
+        slab->tasks[i].next = p->free_list;
+        p->free_list = &slab->tasks[i];
+    }
+}
+
+// 调用者需持有 pool->mutex
+static task_t *task_alloc_locked(thread_pool_t *p) {
+    if (p->free_list == NULL) {
+        slab_grow(p);
+    }
+    task_t *task = p->free_list;
+    p->free_list = task->next;
+    return task;
+}
+
+// 工作线程分配节点：优先使用本地缓存，空了再从全局链表批量补充
+static task_t *task_alloc_local(thread_pool_t *p, worker_t *self) {
+    if (self->free_list == NULL) {
+        pthread_mutex_lock(&p->mutex);
+        for (int i = 0; i < FREE_BATCH; i++) {
+            task_t *task = task_alloc_locked(p);
+            task->next = self->free_list;
+            self->free_list = task;
+        }
+        pthread_mutex_unlock(&p->mutex);
+        self->free_count += FREE_BATCH;
+    }
+
+    task_t *task = self->free_list;
+    self->free_list = task->next;
+    self->free_count--;
+    return task;
+}
+
+// 回收节点：工作线程放回本地缓存，缓存过多时批量归还全局链表
+static void task_free(thread_pool_t *p, task_t *task) {
+    worker_t *self = current_worker;
+
+    if (self == NULL || self->pool != p) {
+        pthread_mutex_lock(&p->mutex);
+        task->next = p->free_list;
+        p->free_list = task;
+        pthread_mutex_unlock(&p->mutex);
+        return;
+    }
+
+    task->next = self->free_list;
+    self->free_list = task;
+    if (++self->free_count <= LOCAL_FREE_MAX) {
+        return;
+    }
+
+    task_t *head = self->free_list;
+    task_t *last = head;
+    for (int i = 1; i < FREE_BATCH; i++) {
+        last = last->next;
+    }
+    self->free_list = last->next;
+    self->free_count -= FREE_BATCH;
+
+    pthread_mutex_lock(&p->mutex);
+    last->next = p->free_list;
+    p->free_list = head;
+    pthread_mutex_unlock(&p->mutex);
+}
+
+static inline int is_urgent(const task_t *task) {
+    return task->priority == PRIO_HIGH || task->deadline_ns != 0;
+}
+
+// 先比优先级再比截止时间：截止时间只在同一优先级内决定先后，不能让低优先级任务越过高优先级 FIFO
+static inline int heap_before(const task_t *a, const task_t *b) {
+    if (a->priority != b->priority) {
+        return a->priority < b->priority;
+    }
+    return a->deadline_ns < b->deadline_ns;
+}
+
+static void heap_swap(task_t **heap, int a, int b) {
+    task_t *tmp = heap[a];
+    heap[a] = heap[b];
+    heap[b] = tmp;
+}
+
+// 调用者需持有 pool->mutex
+static void heap_push(thread_pool_t *p, task_t *task) {
+    if (p->heap_size == p->heap_capacity) {
+        p->heap_capacity = p->heap_capacity ? p->heap_capacity * 2 : 64;
+        p->deadline_heap = realloc(p->deadline_heap, sizeof(task_t *) * p->heap_capacity);
+        if (p->deadline_heap == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int i = p->heap_size++;
+    p->deadline_heap[i] = task;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!heap_before(p->deadline_heap[i], p->deadline_heap[parent])) {
+            break;
+        }
+        heap_swap(p->deadline_heap, parent, i);
+        i = parent;
+    }
+}
+
+// 调用者需持有 pool->mutex
+static task_t *heap_pop(thread_pool_t *p) {
+    task_t **heap = p->deadline_heap;
+    task_t *top = heap[0];
+    int i = 0;
+
+    heap[0] = heap[--p->heap_size];
+    for (;;) {
+        int left = 2 * i + 1, right = left + 1, smallest = i;
+        if (left < p->heap_size && heap_before(heap[left], heap[smallest])) {
+            smallest = left;
+        }
+        if (right < p->heap_size && heap_before(heap[right], heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        heap_swap(heap, i, smallest);
+        i = smallest;
+    }
+    return top;
+}
+
+static int wait_bucket(unsigned long ns) {
+    if (ns < 8) {
+        return (int)ns;
+    }
+    int log = 63 - __builtin_clzl(ns);
+    int bucket = log * 4 + (int)((ns >> (log - 2)) & 3);
+    return bucket < WAIT_HIST_BUCKETS ? bucket : WAIT_HIST_BUCKETS - 1;
+}
+
+// 直方图桶的上界（纳秒）
+static unsigned long wait_bucket_limit(int bucket) {
+    if (bucket < 8) {
+        return (unsigned long)bucket + 1;
+    }
+    int log = bucket / 4;
+    return (1UL << log) + ((unsigned long)(bucket % 4 + 1) << (log - 2));
+}
+
+// 调用者需持有 pool->mutex；带截止时间的任务进堆，其余按优先级尾插 O(1) 入队
+static void global_enqueue(thread_pool_t *p, task_t *task) {
+    prio_stats_t *st = &p->stats[task->priority];
+
+    task->next = NULL;
+    task->enqueue_ns = now_ns();
+
+    if (task->deadline_ns != 0) {
+        heap_push(p, task);
+    } else if (p->queue_tail[task->priority] == NULL) {
+        p->queue_head[task->priority] = task;
+        p->queue_tail[task->priority] = task;
+    } else {
+        p->queue_tail[task->priority]->next = task;
+        p->queue_tail[task->priority] = task;
+    }
+
+    st->enqueued++;
+    if (++st->depth > st->max_depth) {
+        st->max_depth = st->depth;
+    }
+    if (is_urgent(task)) {
+        __atomic_store_n(&p->urgent_count, p->urgent_count + 1, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&p->task_count, p->task_count + 1, __ATOMIC_RELAXED);
+}
+
+static task_t *fifo_pop(thread_pool_t *p, int level) {
+    task_t *task = p->queue_head[level];
+    p->queue_head[level] = task->next;
+    if (p->queue_head[level] == NULL) {
+        p->queue_tail[level] = NULL;
+    }
+    return task;
+}
+
+// 调用者需持有 pool->mutex；正常调度顺序为：优先级最高的非空级别，同一级别内带截止时间的任务
+// 按 EDF 先于该级别的 FIFO。
+// 防饿死：若比正常候选更低的某个 FIFO 队首（或堆顶）已等待超过 starvation_ns，
+// 则每 STARVATION_SHARE 次调度中让出一次给其中等得最久的任务，高优先级延迟仍然有界
+static task_t *global_dequeue(thread_pool_t *p) {
+    unsigned long now = now_ns();
+    task_t *task = NULL;
+    int aged = 0;
+    int level = 0;
+
+    // 正常候选所在的级别，以及它是否取自 EDF 堆（堆顶是堆中优先级最高的任务）
+    int best = PRIO_LEVELS;
+    while (best == PRIO_LEVELS && level < PRIO_LEVELS) {
+        if (p->queue_head[level] != NULL) {
+            best = level;
+        }
+        level++;
+    }
+    task_t *top = p->heap_size > 0 ? p->deadline_heap[0] : NULL;
+    int from_heap = top != NULL && (int)top->priority <= best;
+    if (from_heap) {
+        best = top->priority;
+    }
+
+    if (p->starvation_ns > 0 && ++p->since_aged >= STARVATION_SHARE) {
+        int oldest = -1;
+        for (level = best + 1; level < PRIO_LEVELS; level++) {
+            task_t *head = p->queue_head[level];
+            if (head != NULL && now - head->enqueue_ns > p->starvation_ns &&
+                (oldest < 0 || head->enqueue_ns < p->queue_head[oldest]->enqueue_ns)) {
+                oldest = level;
+            }
+        }
+        if (top != NULL && !from_heap && now - top->enqueue_ns > p->starvation_ns &&
+            (oldest < 0 || top->enqueue_ns < p->queue_head[oldest]->enqueue_ns)) {
+            task = heap_pop(p);
+        } else if (oldest >= 0) {
+            task = fifo_pop(p, oldest);
+        }
+        if (task != NULL) {
+            aged = 1;
+            p->since_aged = 0;
+        }
+    }
+
+    if (task == NULL) {
+        task = from_heap ? heap_pop(p) : fifo_pop(p, best);
+    }
+
+    prio_stats_t *st = &p->stats[task->priority];
+    unsigned long wait = now - task->enqueue_ns;
+    st->dequeued++;
+    st->depth--;
+    st->aged += aged;
+    st->wait_total_ns += wait;
+    if (wait > st->wait_max_ns) {
+        st->wait_max_ns = wait;
+    }
+    st->wait_hist[wait_bucket(wait)]++;
+    if (task->deadline_ns != 0 && now > task->deadline_ns) {
+        st->deadline_missed++;
+    }
+
+    if (is_urgent(task)) {
+        __atomic_store_n(&p->urgent_count, p->urgent_count - 1, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&p->task_count, p->task_count - 1, __ATOMIC_RELAXED);
+
+    if (p->full_waiters > 0) {
+        pthread_cond_signal(&p->not_full);
+    }
+    return task;
+}
+
+// 调用者需持有 pool->mutex；队列达到上限时等待工作线程取走任务
+static void wait_not_full(thread_pool_t *p) {
+    while (p->max_queued > 0 && p->task_count >= p->max_queued && !p->shutdown) {
+        // 批量提交中途阻塞时，先叫醒工作线程处理已入队的部分
+        pthread_cond_broadcast(&p->cond);
+        p->full_waiters++;
+        pthread_cond_wait(&p->not_full, &p->mutex);
+        p->full_waiters--;
+    }
+}
+
+static void run_task(thread_pool_t *p, worker_t *self, task_t *task) {
+    task_latch_t *latch = task->latch;
+
+    task->function(task->arg);
+    task_free(p, task);
+    __atomic_store_n(&self->completed, self->completed + 1, __ATOMIC_RELAXED);
+
+    if (latch != NULL) {
+        latch_count_down(latch);
+    }
+}
+
+// 关闭时丢弃未执行的任务，让等待它们的闭锁不会永远阻塞
+static void cancel_task(task_t *task) {
+    if (task->latch != NULL) {
+        __atomic_add_fetch(&task->latch->cancelled, 1, __ATOMIC_RELAXED);
+        latch_count_down(task->latch);
+    }
+}
+
+// 不加锁也可调用（自旋阶段用来探测新任务）
+static int has_pending_work(thread_pool_t *p) {
+    if (__atomic_load_n(&p->task_count, __ATOMIC_RELAXED) > 0) {
+        return 1;
+    }
+    for (int i = 0; i < p->thread_count; i++) {
+        if (deque_size(&p->workers[i].deque) > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 调用者需持有 pool->mutex；只有确实有线程休眠时才唤醒
+static void signal_locked(thread_pool_t *p, int n) {
+    if (p->idle_count == 0) {
+        p->wakeups_avoided++;
+        return;
+    }
+
+    p->wakeups++;
+    if (n > 1) {
+        pthread_cond_broadcast(&p->cond);
+    } else {
+        pthread_cond_signal(&p->cond);
+    }
+}
+
+// 工作线程压入本地队列后调用；没有线程休眠时完全不碰锁
+static void wake_idle_workers(thread_pool_t *p, worker_t *self, int n) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&p->idle_count, __ATOMIC_RELAXED) > 0) {
+        pthread_mutex_lock(&p->mutex);
+        signal_locked(p, n);
+        pthread_mutex_unlock(&p->mutex);
+    } else {
+        self->wakeups_avoided++;
+    }
+}
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+// 空闲策略：自旋 -> 让出 CPU -> 在条件变量上休眠；发现新任务或线程池关闭时返回
+static void idle_wait(thread_pool_t *p) {
+    for (int i = 0; i < p->spin_iterations; i++) {
+        if (has_pending_work(p) || __atomic_load_n(&p->shutdown, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+        cpu_relax();
+    }
+
+    for (int i = 0; i < p->yield_iterations; i++) {
+        if (has_pending_work(p) || __atomic_load_n(&p->shutdown, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+        sched_yield();
+    }
+
+    // idle_count 与提交方的检查构成 Dekker 式握手，避免丢失唤醒
+    pthread_mutex_lock(&p->mutex);
+    __atomic_add_fetch(&p->idle_count, 1, __ATOMIC_SEQ_CST);
+    if (!p->shutdown && !has_pending_work(p)) {
+        p->parks++;
+        do {
+            pthread_cond_wait(&p->cond, &p->mutex);
+        } while (!p->shutdown && !has_pending_work(p));
+    }
+    __atomic_sub_fetch(&p->idle_count, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&p->mutex);
+}
+
+// 从全局队列搬运一批任务到本地队列，返回其中一个
+static task_t *take_from_global(thread_pool_t *p, worker_t *self) {
+    if (__atomic_load_n(&p->task_count, __ATOMIC_RELAXED) == 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&p->mutex);
+
+    task_t *first = NULL;
+    int moved = 0;
+    if (p->task_count > 0) {
+        first = global_dequeue(p);
+    }
+
+    // 只批量搬运普通任务；有紧急任务排队时逐个取，保持优先级和 EDF 顺序
+    while (moved < INJECT_BATCH - 1 && p->task_count > 0 && p->urgent_count == 0 &&
+           deque_size(&self->deque) < DEQUE_CAPACITY) {
+        deque_push(&self->deque, global_dequeue(p));
+        moved++;
+    }
+
+    pthread_mutex_unlock(&p->mutex);
+
+    // 搬到本地的任务可以被其他空闲线程窃取
+    if (moved > 0) {
+        wake_idle_workers(p, self, 1);
+    }
+    return first;
+}
+
+// 绑核时先窃取同一 NUMA 节点上的线程，减少跨节点访问任务数据
+static task_t *steal_from_others(thread_pool_t *p, worker_t *self) {
+    int n = p->thread_count;
+    int start = rand_r(&self->seed) % n;
+    int passes = self->node >= 0 ? 2 : 1;
+
+    for (int pass = 0; pass < passes; pass++) {
+        for (int i = 0; i < n; i++) {
+            worker_t *victim = &p->workers[(start + i) % n];
+            if (victim == self) {
+                continue;
+            }
+            if (passes == 2 && (victim->node == self->node) != (pass == 0)) {
+                continue;
+            }
+            task_t *task = deque_steal(&victim->deque);
+            if (task != NULL) {
+                self->steals++;
+                return task;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void *global_worker(thread_pool_t *p, worker_t *self) {
+    while (1) {
+        task_t *task = NULL;
+
+        pthread_mutex_lock(&p->mutex);
+
+        if (p->shutdown && (!p->drain || p->task_count == 0)) {
+            pthread_mutex_unlock(&p->mutex);
+            pthread_exit(NULL);
+        }
+
+        if (p->task_count > 0) {
+            task = global_dequeue(p);
+        }
+
+        pthread_mutex_unlock(&p->mutex);
+
+        if (task != NULL) {
+            run_task(p, self, task);
+        } else {
+            idle_wait(p);
+        }
+    }
+
+    return NULL;
+}
+
+static void *stealing_worker(thread_pool_t *p, worker_t *self) {
     while (1) {
-        pthread_mutex_lock(&pool.mutex);
-        
-        while (pool.task_count == 0 && !pool.shutdown) {
-            pthread_cond_wait(&pool.cond, &pool.mutex);
-        }
-        
-        if (pool.shutdown) {
-            pthread_mutex_unlock(&pool.mutex);
+        if (__atomic_load_n(&p->shutdown, __ATOMIC_ACQUIRE) && !p->drain) {
+            pthread_exit(NULL);
+        }
+
+        // 紧急任务 -> 本地 LIFO -> 全局注入队列 -> 随机窃取其他线程 FIFO 端
+        task_t *task = NULL;
+        if (__atomic_load_n(&p->urgent_count, __ATOMIC_RELAXED) > 0) {
+            task = take_from_global(p, self);
+        }
+        if (task == NULL) {
+            task = deque_pop(&self->deque);
+        }
+        if (task == NULL) {
+            task = take_from_global(p, self);
+        }
+        if (task == NULL) {
+            task = steal_from_others(p, self);
+        }
+
+        if (task != NULL) {
+            run_task(p, self, task);
+            continue;
+        }
+
+        idle_wait(p);
+
+        if (__atomic_load_n(&p->shutdown, __ATOMIC_ACQUIRE) && !has_pending_work(p)) {
             pthread_exit(NULL);
         }
-        
-        task_t *task = pool.task_queue;
-        pool.task_queue = task->next;
-        pool.task_count--;
-        
-        pthread_mutex_unlock(&pool.mutex);
-        
-        task->function(task->arg);
-        free(task);
-    }
-    
+    }
+
     return NULL;
 }
 
+void *worker(void *arg) {
+    worker_t *self = (worker_t *)arg;
+    current_worker = self;
+
+    if (self->pool->mode == POOL_MODE_STEALING) {
+        return stealing_worker(self->pool, self);
+    }
+    return global_worker(self->pool, self);
+}
+
 void task_function(void *arg) {
     int id = *(int *)arg;
     printf("任务 %d 执行中\n", id);
@@ -58,67 +803,1095 @@ void task_function(void *arg) {
     free(arg);
 }
 
-void thread_pool_init() {
-    pool.task_queue = NULL;
-    pool.task_count = 0;
-    pool.shutdown = 0;
-    pthread_mutex_init(&pool.mutex, NULL);
-    pthread_cond_init(&pool.cond, NULL);
-    
-    for (int i = 0; i < THREAD_POOL_SIZE; i++) {
-        pthread_create(&pool.threads[i], NULL, worker, NULL);
-    }
+void *square_function(void *arg) {
+    long x = (long)arg;
+    return (void *)(x * x);
 }
 
-void thread_pool_submit(void (*function)(void *), void *arg) {
-    task_t *task = malloc(sizeof(task_t));
-    task->function = function;
-    task->arg = arg;
-    task->next = NULL;
-    
-    pthread_mutex_lock(&pool.mutex);
-    
-    if (pool.task_queue == NULL) {
-        pool.task_queue = task;
-    } else {
-        task_t *current = pool.task_queue;
-        while (current->next != NULL) {
-            current = current->next;
+/* ---------------- CPU 拓扑与绑核 ---------------- */
+
+// 解析 "0-3,8,10-11" 格式的 CPU 列表，返回 CPU 个数，格式错误返回 -1
+static int parse_cpulist(const char *list, int *cpus, int max) {
+    int n = 0;
+    const char *s = list;
+
+    while (*s != '\0' && *s != '\n') {
+        char *end;
+        long first = strtol(s, &end, 10);
+        long last = first;
+
+        if (end == s || first < 0) {
+            return -1;
+        }
+        s = end;
+        if (*s == '-') {
+            last = strtol(s + 1, &end, 10);
+            if (end == s + 1 || last < first) {
+                return -1;
+            }
+            s = end;
+        }
+        for (long cpu = first; cpu <= last && n < max; cpu++) {
+            cpus[n++] = (int)cpu;
+        }
+        if (*s == ',') {
+            s++;
+        } else if (*s != '\0' && *s != '\n') {
+            return -1;
         }
-        current->next = task;
     }
-    
-    pool.task_count++;
-    pthread_cond_signal(&pool.cond);
-    
-    pthread_mutex_unlock(&pool.mutex);
+    return n;
 }
 
-void thread_pool_shutdown() {
-    pthread_mutex_lock(&pool.mutex);
-    pool.shutdown = 1;
-    pthread_cond_broadcast(&pool.cond);
-    pthread_mutex_unlock(&pool.mutex);
-    
-    for (int i = 0; i < THREAD_POOL_SIZE; i++) {
-        pthread_join(pool.threads[i], NULL);
+static int read_sysfs_int(const char *path, int fallback) {
+    FILE *fp = fopen(path, "r");
+    int value;
+
+    if (fp == NULL) {
+        return fallback;
+    }
+    if (fscanf(fp, "%d", &value) != 1) {
+        value = fallback;
     }
-    
-    pthread_mutex_destroy(&pool.mutex);
-    pthread_cond_destroy(&pool.cond);
+    fclose(fp);
+    return value;
 }
 
-int main() {
-    thread_pool_init();
-    
-    for (int i = 0; i < 10; i++) {
-        int *arg = malloc(sizeof(int));
-        *arg = i;
-        thread_pool_submit(task_function, arg);
+static int read_sysfs_cpulist(const char *path, int *cpus, int max) {
+    char buf[4096];
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL) {
+        return -1;
     }
-    
-    sleep(5);
-    thread_pool_shutdown();
-    
-    return 0;
-}
\ No newline at end of file
+    if (fgets(buf, sizeof(buf), fp) == NULL) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    return parse_cpulist(buf, cpus, max);
+}
+
+// 从 /sys/devices/system 读取每个 CPU 的 NUMA 节点、物理封装和物理核编号
+static void read_cpu_topology(cpu_info_t *info, int n) {
+    char path[128];
+    int nodes[MAX_CPUS];
+    int cpus[MAX_CPUS];
+
+    for (int i = 0; i < n; i++) {
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", info[i].cpu);
+        info[i].package = read_sysfs_int(path, 0);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id",
+                 info[i].cpu);
+        info[i].core = read_sysfs_int(path, info[i].cpu);
+        info[i].node = 0;
+        info[i].smt = 0;
+    }
+
+    int node_count = read_sysfs_cpulist("/sys/devices/system/node/online", nodes, MAX_CPUS);
+    for (int k = 0; k < node_count; k++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", nodes[k]);
+        int count = read_sysfs_cpulist(path, cpus, MAX_CPUS);
+        for (int c = 0; c < count; c++) {
+            for (int i = 0; i < n; i++) {
+                if (info[i].cpu == cpus[c]) {
+                    info[i].node = nodes[k];
+                }
+            }
+        }
+    }
+
+    // 同一物理核上的第几个超线程
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < i; j++) {
+            if (info[j].package == info[i].package && info[j].core == info[i].core) {
+                info[i].smt++;
+            }
+        }
+    }
+}
+
+static int compare_compact(const void *a, const void *b) {
+    const cpu_info_t *x = a, *y = b;
+
+    if (x->node != y->node) return x->node - y->node;
+    if (x->smt != y->smt) return x->smt - y->smt;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    return x->cpu - y->cpu;
+}
+
+// 按放置策略生成 CPU 顺序，返回 CPU 个数；0 表示不绑核
+static int plan_placement(const thread_pool_config_t *cfg, cpu_info_t *order) {
+    int cpus[MAX_CPUS];
+    int n = 0;
+
+    if (cfg->pin == PIN_NONE) {
+        return 0;
+    }
+
+    if (cfg->cpulist != NULL) {
+        n = parse_cpulist(cfg->cpulist, cpus, MAX_CPUS);
+        if (n <= 0) {
+            fprintf(stderr, "无效的 CPU 列表: %s，不绑核\n", cfg->cpulist);
+            return 0;
+        }
+    } else {
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            perror("sched_getaffinity");
+            return 0;
+        }
+        for (int cpu = 0; cpu < CPU_SETSIZE && n < MAX_CPUS; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus[n++] = cpu;
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        order[i].cpu = cpus[i];
+    }
+    read_cpu_topology(order, n);
+
+    if (cfg->pin == PIN_LIST) {
+        return n;
+    }
+
+    qsort(order, n, sizeof(cpu_info_t), compare_compact);
+    if (cfg->pin == PIN_SCATTER) {
+        // 紧凑顺序已按节点分组，轮流从每个节点取下一个 CPU
+        cpu_info_t sorted[MAX_CPUS];
+        int taken[MAX_CPUS] = {0};
+        int out = 0;
+
+        memcpy(sorted, order, sizeof(cpu_info_t) * n);
+        while (out < n) {
+            int last_node = -1;
+            for (int i = 0; i < n; i++) {
+                if (!taken[i] && sorted[i].node != last_node) {
+                    order[out++] = sorted[i];
+                    taken[i] = 1;
+                    last_node = sorted[i].node;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+void thread_pool_config_default(thread_pool_config_t *cfg) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    cfg->thread_count = cpus > 0 ? (int)cpus : THREAD_POOL_SIZE;
+    cfg->mode = POOL_MODE_GLOBAL;
+    cfg->max_queued = 0;
+    cfg->pin = PIN_NONE;
+    cfg->cpulist = NULL;
+    cfg->spin_iterations = IDLE_SPIN_DEFAULT;
+    cfg->yield_iterations = IDLE_YIELD_DEFAULT;
+    cfg->starvation_ms = STARVATION_MS_DEFAULT;
+}
+
+void thread_pool_init(thread_pool_t *p, const thread_pool_config_t *cfg) {
+    int thread_count = cfg->thread_count;
+    cpu_info_t placement[MAX_CPUS];
+    int placement_count = plan_placement(cfg, placement);
+
+    if (thread_count <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cpus > 0 ? (int)cpus : THREAD_POOL_SIZE;
+    }
+
+    p->mode = cfg->mode;
+    p->thread_count = thread_count;
+    for (int level = 0; level < PRIO_LEVELS; level++) {
+        p->queue_head[level] = NULL;
+        p->queue_tail[level] = NULL;
+    }
+    p->deadline_heap = NULL;
+    p->heap_size = 0;
+    p->heap_capacity = 0;
+    p->task_count = 0;
+    p->urgent_count = 0;
+    p->starvation_ns = cfg->starvation_ms * 1000000UL;
+    p->since_aged = 0;
+    memset(p->stats, 0, sizeof(p->stats));
+    p->max_queued = cfg->max_queued;
+    p->full_waiters = 0;
+    p->idle_count = 0;
+    p->spin_iterations = cfg->spin_iterations;
+    p->yield_iterations = cfg->yield_iterations;
+    p->parks = 0;
+    p->wakeups = 0;
+    p->wakeups_avoided = 0;
+    p->shutdown = 0;
+    p->drain = 0;
+    p->free_list = NULL;
+    p->slabs = NULL;
+    p->alloc_calls = 0;
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    pthread_cond_init(&p->not_full, NULL);
+
+    p->threads = malloc(sizeof(pthread_t) * thread_count);
+    if (p->threads == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    if (posix_memalign((void **)&p->workers, CACHE_LINE,
+                       sizeof(worker_t) * thread_count) != 0) {
+        perror("posix_memalign");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < thread_count; i++) {
+        deque_init(&p->workers[i].deque);
+        p->workers[i].pool = p;
+        p->workers[i].id = i;
+        p->workers[i].cpu = -1;
+        p->workers[i].node = -1;
+        p->workers[i].seed = (unsigned int)i * 2654435761u + 1;
+        p->workers[i].steals = 0;
+        p->workers[i].completed = 0;
+        p->workers[i].wakeups_avoided = 0;
+        p->workers[i].free_list = NULL;
+        p->workers[i].free_count = 0;
+    }
+
+    for (int i = 0; i < thread_count; i++) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+
+        // 线程数多于 CPU 时循环使用放置顺序
+        if (placement_count > 0) {
+            cpu_info_t *where = &placement[i % placement_count];
+            cpu_set_t set;
+
+            CPU_ZERO(&set);
+            CPU_SET(where->cpu, &set);
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+            p->workers[i].cpu = where->cpu;
+            p->workers[i].node = where->node;
+        }
+
+        if (pthread_create(&p->threads[i], &attr, worker, &p->workers[i]) != 0) {
+            // 目标 CPU 不在允许范围内时退回到不绑核
+            fprintf(stderr, "线程 %d 无法绑定到 CPU %d，改为不绑核\n", i, p->workers[i].cpu);
+            p->workers[i].cpu = -1;
+            p->workers[i].node = -1;
+            if (pthread_create(&p->threads[i], NULL, worker, &p->workers[i]) != 0) {
+                perror("pthread_create");
+                exit(EXIT_FAILURE);
+            }
+        }
+        pthread_attr_destroy(&attr);
+    }
+}
+
+// 提交 n 个任务：外部线程只加一次锁、只唤醒一次；工作线程在窃取模式下直接压入本地队列
+static int submit_tasks(thread_pool_t *p, void (*function)(void *), void *args[], int n,
+                        const task_opts_t *opts, task_latch_t *latch) {
+    worker_t *self = current_worker;
+    int priority = opts != NULL ? (int)opts->priority : PRIO_NORMAL;
+    unsigned long deadline = 0;
+
+    if (priority < 0 || priority >= PRIO_LEVELS) {
+        priority = PRIO_NORMAL;
+    }
+    if (opts != NULL && opts->deadline_us > 0) {
+        deadline = now_ns() + opts->deadline_us * 1000UL;
+    }
+
+    if (self != NULL && self->pool == p) {
+        task_t *overflow = NULL, *overflow_tail = NULL;
+        int pushed = 0;
+        // 本地双端队列不区分优先级，只接收普通任务
+        int local_ok = p->mode == POOL_MODE_STEALING && priority == PRIO_NORMAL && deadline == 0;
+
+        for (int i = 0; i < n; i++) {
+            task_t *task = task_alloc_local(p, self);
+            task->function = function;
+            task->arg = args[i];
+            task->latch = latch;
+            task->priority = priority;
+            task->deadline_ns = deadline;
+
+            if (local_ok && deque_push(&self->deque, task) == 0) {
+                pushed++;
+                continue;
+            }
+            task->next = NULL;
+            if (overflow_tail == NULL) {
+                overflow = task;
+            } else {
+                overflow_tail->next = task;
+            }
+            overflow_tail = task;
+        }
+
+        if (pushed > 0) {
+            wake_idle_workers(p, self, pushed);
+        }
+        if (overflow == NULL) {
+            return 0;
+        }
+
+        // 工作线程提交时不做背压，否则所有工作线程可能都阻塞在这里
+        pthread_mutex_lock(&p->mutex);
+        while (overflow != NULL) {
+            task_t *next = overflow->next;
+            global_enqueue(p, overflow);
+            overflow = next;
+        }
+        signal_locked(p, 2);
+        pthread_mutex_unlock(&p->mutex);
+        return 0;
+    }
+
+    pthread_mutex_lock(&p->mutex);
+
+    int submitted = 0;
+    while (submitted < n) {
+        wait_not_full(p);
+        if (p->shutdown) {
+            break;
+        }
+
+        task_t *task = task_alloc_locked(p);
+        task->function = function;
+        task->arg = args[submitted];
+        task->latch = latch;
+        task->priority = priority;
+        task->deadline_ns = deadline;
+        global_enqueue(p, task);
+        submitted++;
+    }
+
+    if (submitted > 0) {
+        signal_locked(p, submitted);
+    }
+
+    pthread_mutex_unlock(&p->mutex);
+
+    // 线程池已关闭：没能提交的任务按取消处理
+    if (submitted < n) {
+        for (int i = submitted; i < n && latch != NULL; i++) {
+            __atomic_add_fetch(&latch->cancelled, 1, __ATOMIC_RELAXED);
+            latch_count_down(latch);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+int thread_pool_submit(thread_pool_t *p, void (*function)(void *), void *arg) {
+    return submit_tasks(p, function, &arg, 1, NULL, NULL);
+}
+
+// 以同一函数批量提交 n 个任务；latch 非空时每个任务完成后递减一次
+int thread_pool_submit_batch(thread_pool_t *p, void (*function)(void *), void *args[], int n,
+                             task_latch_t *latch) {
+    return submit_tasks(p, function, args, n, NULL, latch);
+}
+
+// 按指定优先级和截止时间提交；高优先级和带截止时间的任务总是经过全局队列
+int thread_pool_submit_ex(thread_pool_t *p, void (*function)(void *), void *arg,
+                          const task_opts_t *opts, task_latch_t *latch) {
+    return submit_tasks(p, function, &arg, 1, opts, latch);
+}
+
+static void future_run(void *arg) {
+    task_future_t *future = (task_future_t *)arg;
+    future->result = future->function(future->arg);
+}
+
+int thread_pool_submit_future(thread_pool_t *p, task_future_t *future,
+                              void *(*function)(void *), void *arg) {
+    void *args[1] = {future};
+
+    future->function = function;
+    future->arg = arg;
+    future->result = NULL;
+    latch_init(&future->latch, 1);
+    return submit_tasks(p, future_run, args, 1, NULL, &future->latch);
+}
+
+// 等待任务完成并返回结果；任务被取消时返回 NULL，*cancelled 置 1
+void *future_get(task_future_t *future, int *cancelled) {
+    latch_wait(&future->latch);
+    if (cancelled != NULL) {
+        *cancelled = future->latch.cancelled > 0;
+    }
+    return future->result;
+}
+
+void future_destroy(task_future_t *future) {
+    latch_destroy(&future->latch);
+}
+
+void thread_pool_shutdown(thread_pool_t *p, shutdown_mode_t how) {
+    pthread_mutex_lock(&p->mutex);
+    p->drain = how == SHUTDOWN_DRAIN;
+    __atomic_store_n(&p->shutdown, 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&p->cond);
+    pthread_cond_broadcast(&p->not_full);
+    pthread_mutex_unlock(&p->mutex);
+
+    for (int i = 0; i < p->thread_count; i++) {
+        pthread_join(p->threads[i], NULL);
+    }
+
+    // 工作线程都已退出，剩下的只可能是被丢弃的任务
+    while (p->task_count > 0) {
+        cancel_task(global_dequeue(p));
+    }
+    for (int i = 0; i < p->thread_count; i++) {
+        task_t *task;
+        while ((task = deque_steal(&p->workers[i].deque)) != NULL) {
+            cancel_task(task);
+        }
+    }
+
+    // 所有任务节点（包括未执行的）都来自 slab，一并释放
+    while (p->slabs != NULL) {
+        task_slab_t *next = p->slabs->next;
+        free(p->slabs);
+        p->slabs = next;
+    }
+
+    pthread_mutex_destroy(&p->mutex);
+    pthread_cond_destroy(&p->cond);
+    pthread_cond_destroy(&p->not_full);
+    free(p->deadline_heap);
+    free(p->threads);
+    free(p->workers);
+}
+
+void thread_pool_prio_stats(thread_pool_t *p, task_priority_t priority, prio_stats_t *out) {
+    pthread_mutex_lock(&p->mutex);
+    *out = p->stats[priority];
+    pthread_mutex_unlock(&p->mutex);
+}
+
+// 由直方图估算等待时间分位数（纳秒），误差不超过所在桶宽度
+unsigned long prio_stats_percentile(const prio_stats_t *st, double q) {
+    unsigned long target = (unsigned long)(st->dequeued * q);
+    unsigned long seen = 0;
+
+    for (int b = 0; b < WAIT_HIST_BUCKETS; b++) {
+        seen += st->wait_hist[b];
+        if (seen > target) {
+            return wait_bucket_limit(b);
+        }
+    }
+    return st->wait_max_ns;
+}
+
+// 汇总省掉的唤醒次数；工作线程运行时读取，结果可能略有滞后
+unsigned long thread_pool_wakeups_avoided(thread_pool_t *p) {
+    unsigned long total = p->wakeups_avoided;
+    for (int i = 0; i < p->thread_count; i++) {
+        total += p->workers[i].wakeups_avoided;
+    }
+    return total;
+}
+
+unsigned long thread_pool_completed(thread_pool_t *p) {
+    unsigned long total = 0;
+    for (int i = 0; i < p->thread_count; i++) {
+        total += __atomic_load_n(&p->workers[i].completed, __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+/* ---------------- 性能测试：全局队列 vs 工作窃取 ---------------- */
+
+typedef struct {
+    thread_pool_t *pool;
+    long chain_length;          // 每条任务链的长度
+    int work;                   // 每个任务的空转次数，模拟小任务
+    task_latch_t done;          // 每条任务链结束时递减一次
+} bench_state_t;
+
+typedef struct {
+    bench_state_t *state;
+    long left;
+} bench_chain_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 每个任务做少量计算后提交链上的下一个任务，模拟 fork-join 式的任务内提交
+static void bench_task(void *arg) {
+    bench_chain_t *chain = (bench_chain_t *)arg;
+    bench_state_t *state = chain->state;
+
+    for (volatile int i = 0; i < state->work; i++) {
+    }
+
+    if (--chain->left > 0) {
+        thread_pool_submit(state->pool, bench_task, chain);
+        return;
+    }
+
+    latch_count_down(&state->done);
+}
+
+static double bench_run(pool_mode_t mode, int threads, long total_tasks, int work) {
+    thread_pool_t p;
+    thread_pool_config_t cfg;
+    bench_state_t state;
+    int chains = threads * 8;
+    bench_chain_t *chain = malloc(sizeof(bench_chain_t) * chains);
+    if (chain == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    state.pool = &p;
+    state.chain_length = total_tasks / chains;
+    state.work = work;
+    latch_init(&state.done, chains);
+
+    thread_pool_config_default(&cfg);
+    cfg.thread_count = threads;
+    cfg.mode = mode;
+    thread_pool_init(&p, &cfg);
+
+    double start = now_sec();
+
+    for (int i = 0; i < chains; i++) {
+        chain[i].state = &state;
+        chain[i].left = state.chain_length;
+        thread_pool_submit(&p, bench_task, &chain[i]);
+    }
+
+    latch_wait(&state.done);
+
+    double elapsed = now_sec() - start;
+
+    thread_pool_shutdown(&p, SHUTDOWN_DRAIN);
+    latch_destroy(&state.done);
+    free(chain);
+
+    return (double)state.chain_length * chains / elapsed;
+}
+
+static void bench_stealing(int max_threads, long total_tasks, int work) {
+    printf("任务吞吐量测试: 共 %ld 个任务，每任务空转 %d 次\n", total_tasks, work);
+    printf("%-8s %16s %16s %8s\n", "线程数", "全局队列(任务/秒)", "工作窃取(任务/秒)", "加速比");
+
+    for (int threads = 1; ; threads *= 2) {
+        if (threads > max_threads) {
+            threads = max_threads;
+        }
+
+        double global = bench_run(POOL_MODE_GLOBAL, threads, total_tasks, work);
+        double stealing = bench_run(POOL_MODE_STEALING, threads, total_tasks, work);
+        printf("%-8d %16.0f %16.0f %7.2fx\n", threads, global, stealing, stealing / global);
+
+        if (threads == max_threads) {
+            break;
+        }
+    }
+}
+
+/* ---------------- 微基准：提交开销与堆分配次数 ---------------- */
+
+static void empty_task(void *arg) {
+    (void)arg;
+}
+
+static void bench_submit_run(pool_mode_t mode, int threads, long tasks, int max_queued,
+                             int batch) {
+    thread_pool_t p;
+    thread_pool_config_t cfg;
+    struct timespec pause = {0, 1000000};
+    void **args = calloc(batch, sizeof(void *));
+    if (args == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    thread_pool_config_default(&cfg);
+    cfg.thread_count = threads;
+    cfg.mode = mode;
+    cfg.max_queued = max_queued;
+    thread_pool_init(&p, &cfg);
+
+    double start = now_sec();
+    if (batch > 1) {
+        for (long i = 0; i < tasks; i += batch) {
+            int n = tasks - i < batch ? (int)(tasks - i) : batch;
+            thread_pool_submit_batch(&p, empty_task, args, n, NULL);
+        }
+    } else {
+        for (long i = 0; i < tasks; i++) {
+            thread_pool_submit(&p, empty_task, NULL);
+        }
+    }
+    double submitted = now_sec();
+
+    while (thread_pool_completed(&p) < (unsigned long)tasks) {
+        nanosleep(&pause, NULL);
+    }
+    double drained = now_sec();
+
+    pthread_mutex_lock(&p.mutex);
+    unsigned long alloc_calls = p.alloc_calls;
+    pthread_mutex_unlock(&p.mutex);
+
+    printf("%-10s %12d %10d %12.1f %14.3f %12lu\n",
+           mode == POOL_MODE_GLOBAL ? "全局队列" : "工作窃取", max_queued, batch,
+           (submitted - start) * 1e9 / tasks, drained - start, alloc_calls);
+
+    thread_pool_shutdown(&p, SHUTDOWN_DRAIN);
+    free(args);
+}
+
+static void bench_submit(long tasks, int threads) {
+    printf("提交微基准: %ld 个空任务, %d 个工作线程 (旧实现每次提交 1 次 malloc + 1 次 free)\n",
+           tasks, threads);
+    printf("%-10s %12s %10s %12s %14s %12s\n",
+           "模式", "队列上限", "批量大小", "纳秒/提交", "总耗时(秒)", "堆分配次数");
+
+    bench_submit_run(POOL_MODE_GLOBAL, threads, tasks, 0, 1);
+    bench_submit_run(POOL_MODE_GLOBAL, threads, tasks, 4096, 1);
+    bench_submit_run(POOL_MODE_GLOBAL, threads, tasks, 4096, 64);
+    bench_submit_run(POOL_MODE_STEALING, threads, tasks, 0, 1);
+    bench_submit_run(POOL_MODE_STEALING, threads, tasks, 4096, 1);
+    bench_submit_run(POOL_MODE_STEALING, threads, tasks, 4096, 64);
+}
+
+/* ---------------- 性能测试：绑核与拓扑放置 ---------------- */
+
+#define AFFINITY_BUF_SIZE (16 * 1024 * 1024)
+#define AFFINITY_TASKS_PER_THREAD 64
+
+typedef struct {
+    long *buffers[MAX_CPUS];    // 每个工作线程一块缓冲区，由该线程首次访问（first-touch）
+    long bytes;
+} affinity_state_t;
+
+static affinity_state_t affinity_state;
+
+// 3/4 的任务顺序扫描本线程的缓冲区（访存密集），1/4 做纯计算
+static void affinity_task(void *arg) {
+    long id = (long)arg;
+    int self = current_worker->id;
+    long n = AFFINITY_BUF_SIZE / sizeof(long);
+
+    if (affinity_state.buffers[self] == NULL) {
+        long *buf = malloc(AFFINITY_BUF_SIZE);
+        if (buf == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        for (long i = 0; i < n; i++) {
+            buf[i] = i;
+        }
+        affinity_state.buffers[self] = buf;
+    }
+
+    if (id % 4 != 3) {
+        long *buf = affinity_state.buffers[self];
+        volatile long sum = 0;
+        long local = 0;
+        for (long i = 0; i < n; i++) {
+            local += buf[i];
+        }
+        sum = local;
+        (void)sum;
+        __atomic_add_fetch(&affinity_state.bytes, AFFINITY_BUF_SIZE, __ATOMIC_RELAXED);
+    } else {
+        for (volatile int i = 0; i < 1000000; i++) {
+        }
+    }
+}
+
+static void bench_affinity_run(int threads, const char *cpulist, pin_policy_t pin,
+                               const char *name) {
+    thread_pool_t p;
+    thread_pool_config_t cfg;
+    task_latch_t latch;
+    int tasks = threads * AFFINITY_TASKS_PER_THREAD;
+    void **args = malloc(sizeof(void *) * tasks);
+    if (args == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&affinity_state, 0, sizeof(affinity_state));
+    for (int i = 0; i < tasks; i++) {
+        args[i] = (void *)(long)i;
+    }
+
+    thread_pool_config_default(&cfg);
+    cfg.thread_count = threads;
+    cfg.mode = POOL_MODE_STEALING;
+    cfg.pin = pin;
+    cfg.cpulist = cpulist;
+    thread_pool_init(&p, &cfg);
+
+    printf("%-8s 放置:", name);
+    for (int i = 0; i < p.thread_count; i++) {
+        if (p.workers[i].cpu >= 0) {
+            printf(" %d@cpu%d/node%d", i, p.workers[i].cpu, p.workers[i].node);
+        } else {
+            printf(" %d@*", i);
+        }
+    }
+    printf("\n");
+
+    // 先让每个线程完成首次访问，再计时
+    latch_init(&latch, tasks);
+    thread_pool_submit_batch(&p, affinity_task, args, tasks, &latch);
+    latch_wait(&latch);
+    latch_destroy(&latch);
+    affinity_state.bytes = 0;
+
+    latch_init(&latch, tasks);
+    double start = now_sec();
+    thread_pool_submit_batch(&p, affinity_task, args, tasks, &latch);
+    latch_wait(&latch);
+    double elapsed = now_sec() - start;
+    latch_destroy(&latch);
+
+    printf("%-8s 耗时 %.3f 秒, 扫描带宽 %.2f GB/s, 任务 %.0f 个/秒\n", name, elapsed,
+           affinity_state.bytes / elapsed / 1e9, tasks / elapsed);
+
+    thread_pool_shutdown(&p, SHUTDOWN_DRAIN);
+    for (int i = 0; i < MAX_CPUS; i++) {
+        free(affinity_state.buffers[i]);
+    }
+    free(args);
+}
+
+static void bench_affinity(int threads, const char *cpulist) {
+    printf("绑核测试: %d 个线程, CPU 列表 %s, 每线程缓冲区 %d MB\n", threads,
+           cpulist != NULL ? cpulist : "(全部)", AFFINITY_BUF_SIZE / (1024 * 1024));
+
+    bench_affinity_run(threads, cpulist, PIN_NONE, "不绑核");
+    bench_affinity_run(threads, cpulist, PIN_COMPACT, "紧凑");
+    bench_affinity_run(threads, cpulist, PIN_SCATTER, "分散");
+}
+
+/* ---------------- 性能测试：空闲策略 ---------------- */
+
+typedef struct {
+    const char *name;
+    int spin;
+    int yield;
+} idle_policy_t;
+
+static const idle_policy_t idle_policies[] = {
+    {"直接休眠", 0, 0},
+    {"让出CPU", 0, 64},
+    {"纯自旋", 200000, 0},
+    {"自适应", IDLE_SPIN_DEFAULT, IDLE_YIELD_DEFAULT},
+};
+
+typedef struct {
+    unsigned long submit_ns;
+    unsigned long start_ns;
+} latency_sample_t;
+
+static void latency_task(void *arg) {
+    latency_sample_t *sample = (latency_sample_t *)arg;
+    sample->start_ns = now_ns();
+    for (volatile int i = 0; i < 200; i++) {
+    }
+}
+
+static int compare_ulong(const void *a, const void *b) {
+    unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+    return x < y ? -1 : x > y;
+}
+
+// 突发负载：每轮连续提交 burst 个任务，然后空闲 gap_us 微秒，让工作线程进入空闲状态
+static void bench_idle_run(pool_mode_t mode, const idle_policy_t *policy, int threads,
+                           int bursts, int burst, int gap_us) {
+    thread_pool_t p;
+    thread_pool_config_t cfg;
+    task_latch_t latch;
+    long tasks = (long)bursts * burst;
+    latency_sample_t *samples = calloc(tasks, sizeof(latency_sample_t));
+    unsigned long *delays = malloc(sizeof(unsigned long) * tasks);
+    struct timespec gap = {0, gap_us * 1000L};
+
+    if (samples == NULL || delays == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    thread_pool_config_default(&cfg);
+    cfg.thread_count = threads;
+    cfg.mode = mode;
+    cfg.spin_iterations = policy->spin;
+    cfg.yield_iterations = policy->yield;
+    thread_pool_init(&p, &cfg);
+
+    latch_init(&latch, (int)tasks);
+    double start = now_sec();
+    for (int b = 0; b < bursts; b++) {
+        for (int i = 0; i < burst; i++) {
+            latency_sample_t *sample = &samples[(long)b * burst + i];
+            void *args[1] = {sample};
+            sample->submit_ns = now_ns();
+            thread_pool_submit_batch(&p, latency_task, args, 1, &latch);
+        }
+        if (gap_us > 0) {
+            nanosleep(&gap, NULL);
+        }
+    }
+    latch_wait(&latch);
+    double elapsed = now_sec() - start;
+    latch_destroy(&latch);
+
+    for (long i = 0; i < tasks; i++) {
+        delays[i] = samples[i].start_ns - samples[i].submit_ns;
+    }
+    qsort(delays, tasks, sizeof(unsigned long), compare_ulong);
+
+    pthread_mutex_lock(&p.mutex);
+    unsigned long parks = p.parks, wakeups = p.wakeups;
+    pthread_mutex_unlock(&p.mutex);
+
+    printf("%-10s %-10s %12.0f %10.1f %10.1f %10lu %10lu %10lu\n",
+           mode == POOL_MODE_GLOBAL ? "全局队列" : "工作窃取", policy->name, tasks / elapsed,
+           delays[tasks / 2] / 1e3, delays[tasks * 99 / 100] / 1e3,
+           parks, wakeups, thread_pool_wakeups_avoided(&p));
+
+    thread_pool_shutdown(&p, SHUTDOWN_DRAIN);
+    free(samples);
+    free(delays);
+}
+
+static void bench_idle(int threads, int bursts, int burst, int gap_us) {
+    printf("空闲策略测试: %d 个线程, %d 轮突发, 每轮 %d 个任务, 间隔 %d 微秒\n",
+           threads, bursts, burst, gap_us);
+    printf("%-10s %-10s %12s %10s %10s %10s %10s %10s\n", "模式", "策略", "任务/秒",
+           "p50(us)", "p99(us)", "休眠次数", "唤醒次数", "省掉唤醒");
+
+    for (int mode = POOL_MODE_GLOBAL; mode <= POOL_MODE_STEALING; mode++) {
+        for (size_t i = 0; i < sizeof(idle_policies) / sizeof(idle_policies[0]); i++) {
+            bench_idle_run((pool_mode_t)mode, &idle_policies[i], threads, bursts, burst, gap_us);
+        }
+    }
+}
+
+/* ---------------- 性能测试：优先级与截止时间 ---------------- */
+
+typedef struct {
+    unsigned long submit_ns;
+    unsigned long start_ns;
+    int spin;
+} prio_sample_t;
+
+static void prio_task(void *arg) {
+    prio_sample_t *sample = (prio_sample_t *)arg;
+    sample->start_ns = now_ns();
+    for (volatile int i = 0; i < sample->spin; i++) {
+    }
+}
+
+static void print_sample_wait(const char *name, prio_sample_t *samples, int n) {
+    unsigned long *delays = malloc(sizeof(unsigned long) * n);
+    if (delays == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < n; i++) {
+        delays[i] = samples[i].start_ns - samples[i].submit_ns;
+    }
+    qsort(delays, n, sizeof(unsigned long), compare_ulong);
+    printf("  %-12s %8d 个, 等待 p50 %10.1f us, p99 %10.1f us, 最大 %10.1f us\n", name, n,
+           delays[n / 2] / 1e3, delays[n * 99 / 100] / 1e3, delays[n - 1] / 1e3);
+    free(delays);
+}
+
+// 先压入大量低优先级批量任务使线程池饱和，再周期性提交延迟敏感任务
+static void bench_prio_run(const char *title, int threads, int bulk, int urgent,
+                           task_priority_t urgent_prio, unsigned long deadline_us,
+                           int starvation_ms) {
+    thread_pool_t p;
+    thread_pool_config_t cfg;
+    task_latch_t latch;
+    prio_sample_t *bulk_samples = calloc(bulk, sizeof(prio_sample_t));
+    prio_sample_t *urgent_samples = calloc(urgent, sizeof(prio_sample_t));
+    task_opts_t bulk_opts = {PRIO_LOW, 0};
+    task_opts_t urgent_opts = {urgent_prio, deadline_us};
+    struct timespec interval = {0, 1000000};
+
+    if (bulk_samples == NULL || urgent_samples == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    // FIFO 对照组：所有任务同一优先级
+    if (urgent_prio == PRIO_NORMAL && deadline_us == 0) {
+        bulk_opts.priority = PRIO_NORMAL;
+    }
+
+    thread_pool_config_default(&cfg);
+    cfg.thread_count = threads;
+    cfg.starvation_ms = starvation_ms;
+    thread_pool_init(&p, &cfg);
+
+    latch_init(&latch, bulk + urgent);
+    for (int i = 0; i < bulk; i++) {
+        bulk_samples[i].spin = 20000;
+        bulk_samples[i].submit_ns = now_ns();
+        thread_pool_submit_ex(&p, prio_task, &bulk_samples[i], &bulk_opts, &latch);
+    }
+    for (int i = 0; i < urgent; i++) {
+        nanosleep(&interval, NULL);
+        urgent_samples[i].spin = 1000;
+        urgent_samples[i].submit_ns = now_ns();
+        thread_pool_submit_ex(&p, prio_task, &urgent_samples[i], &urgent_opts, &latch);
+    }
+    latch_wait(&latch);
+    latch_destroy(&latch);
+
+    printf("%s\n", title);
+    print_sample_wait("延迟敏感", urgent_samples, urgent);
+    print_sample_wait("批量", bulk_samples, bulk);
+
+    for (int level = 0; level < PRIO_LEVELS; level++) {
+        prio_stats_t st;
+        static const char *names[PRIO_LEVELS] = {"HIGH", "NORMAL", "LOW"};
+
+        thread_pool_prio_stats(&p, (task_priority_t)level, &st);
+        if (st.dequeued == 0) {
+            continue;
+        }
+        printf("  [%-6s] 最大深度 %6d, 平均等待 %10.1f us, p99 %10.1f us, "
+               "防饿死调度 %lu, 超过截止时间 %lu\n",
+               names[level], st.max_depth, st.wait_total_ns / 1e3 / st.dequeued,
+               prio_stats_percentile(&st, 0.99) / 1e3, st.aged, st.deadline_missed);
+    }
+
+    thread_pool_shutdown(&p, SHUTDOWN_DRAIN);
+    free(bulk_samples);
+    free(urgent_samples);
+}
+
+static void bench_prio(int threads, int bulk, int urgent) {
+    printf("优先级测试: %d 个线程, %d 个批量任务, 每毫秒提交 1 个延迟敏感任务共 %d 个\n",
+           threads, bulk, urgent);
+
+    bench_prio_run("单一 FIFO（对照组）:", threads, bulk, urgent, PRIO_NORMAL, 0, 0);
+    bench_prio_run("高优先级 + 防饿死:", threads, bulk, urgent, PRIO_HIGH, 0,
+                   STARVATION_MS_DEFAULT);
+    bench_prio_run("截止时间 2ms（EDF）+ 防饿死:", threads, bulk, urgent, PRIO_HIGH, 2000,
+                   STARVATION_MS_DEFAULT);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        int max_threads = argc > 2 ? atoi(argv[2]) : (cpus > 0 ? (int)cpus : THREAD_POOL_SIZE);
+        long total_tasks = argc > 3 ? atol(argv[3]) : 2000000;
+        int work = argc > 4 ? atoi(argv[4]) : 100;
+
+        if (max_threads < 1) {
+            max_threads = 1;
+        }
+        bench_stealing(max_threads, total_tasks, work);
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "bench-submit") == 0) {
+        long tasks = argc > 2 ? atol(argv[2]) : 10000000;
+        int threads = argc > 3 ? atoi(argv[3]) : THREAD_POOL_SIZE;
+
+        if (tasks < 1 || threads < 1) {
+            fprintf(stderr, "用法: %s bench-submit [任务数] [线程数]\n", argv[0]);
+            return 1;
+        }
+        bench_submit(tasks, threads);
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "bench-affinity") == 0) {
+        thread_pool_config_t defaults;
+        thread_pool_config_default(&defaults);
+        int threads = argc > 2 ? atoi(argv[2]) : defaults.thread_count;
+        const char *cpulist = argc > 3 ? argv[3] : NULL;
+
+        if (threads < 1 || threads > MAX_CPUS) {
+            fprintf(stderr, "用法: %s bench-affinity [线程数] [CPU 列表]\n", argv[0]);
+            return 1;
+        }
+        bench_affinity(threads, cpulist);
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "bench-idle") == 0) {
+        int threads = argc > 2 ? atoi(argv[2]) : THREAD_POOL_SIZE;
+        int bursts = argc > 3 ? atoi(argv[3]) : 2000;
+        int burst = argc > 4 ? atoi(argv[4]) : 16;
+        int gap_us = argc > 5 ? atoi(argv[5]) : 50;
+
+        if (threads < 1 || bursts < 1 || burst < 1 || gap_us < 0) {
+            fprintf(stderr, "用法: %s bench-idle [线程数] [突发轮数] [每轮任务数] [间隔微秒]\n",
+                    argv[0]);
+            return 1;
+        }
+        bench_idle(threads, bursts, burst, gap_us);
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "bench-prio") == 0) {
+        int threads = argc > 2 ? atoi(argv[2]) : THREAD_POOL_SIZE;
+        int bulk = argc > 3 ? atoi(argv[3]) : 20000;
+        int urgent = argc > 4 ? atoi(argv[4]) : 200;
+
+        if (threads < 1 || bulk < 1 || urgent < 1) {
+            fprintf(stderr, "用法: %s bench-prio [线程数] [批量任务数] [延迟敏感任务数]\n",
+                    argv[0]);
+            return 1;
+        }
+        bench_prio(threads, bulk, urgent);
+        return 0;
+    }
+
+    thread_pool_config_t cfg;
+    thread_pool_config_default(&cfg);
+    thread_pool_init(&pool, &cfg);
+
+    // 一次提交 10 个任务，用闭锁等待全部完成，而不是 sleep
+    void *args[10];
+    task_latch_t latch;
+    latch_init(&latch, 10);
+    for (int i = 0; i < 10; i++) {
+        int *arg = malloc(sizeof(int));
+        if (arg == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        *arg = i;
+        args[i] = arg;
+    }
+    thread_pool_submit_batch(&pool, task_function, args, 10, &latch);
+
+    latch_wait(&latch);
+    printf("全部 10 个任务完成\n");
+    latch_destroy(&latch);
+
+    // future：提交带返回值的任务并等待结果
+    task_future_t future;
+    thread_pool_submit_future(&pool, &future, square_function, (void *)(long)12);
+    printf("12 的平方 = %ld\n", (long)future_get(&future, NULL));
+    future_destroy(&future);
+
+    thread_pool_shutdown(&pool, SHUTDOWN_DRAIN);
+
+    return 0;
+}
@@ -1,27 +1,41 @@
 #include <stdio.h>
+#include <math.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
-#define SIZE 10000
+#include "perf_counters.h"
+
+#define SIZE 10000000
 #define THREADS 4
+#define INSERTION_CUTOFF 32     // 小于该长度直接插入排序
+#define SORT_CUTOFF 16384       // 小于该长度不再派生线程
+#define MERGE_CUTOFF 65536      // 合并总长度小于该值时顺序合并
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_MIN_PER_THREAD 65536  // 每个线程至少处理的元素数，避免小数组上线程开销占主导
+#define WC_BYTES 64             // 每个桶的写合并缓冲区大小（一个缓存行）
 
-int array[SIZE];
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+int *array;
+int *scratch;                   // 预先分配的辅助缓冲区，与 array 等长
+static perf_counters_t perf;    // 各计时区间共用的硬件性能计数器
+long size = SIZE;
 
+// 顺序归并：array[left..mid] 与 array[mid+1..right] 合并，借用 scratch 的同一区间
 void merge(int left, int mid, int right) {
     int n1 = mid - left + 1;
     int n2 = right - mid;
-    
-    int L[n1], R[n2];
-    
-    for (int i = 0; i < n1; i++)
-        L[i] = array[left + i];
-    for (int j = 0; j < n2; j++)
-        R[j] = array[mid + 1 + j];
-    
+
+    int *L = scratch + left, *R = scratch + mid + 1;
+
+    memcpy(L, array + left, sizeof(int) * n1);
+    memcpy(R, array + mid + 1, sizeof(int) * n2);
+
     int i = 0, j = 0, k = left;
-    
+
     while (i < n1 && j < n2) {
         if (L[i] <= R[j]) {
             array[k] = L[i];
@@ -32,13 +46,13 @@ void merge(int left, int mid, int right) {
         }
         k++;
     }
-    
+
     while (i < n1) {
         array[k] = L[i];
         i++;
         k++;
     }
-    
+
     while (j < n2) {
         array[k] = R[j];
         j++;
@@ -55,63 +69,697 @@ void merge_sort(int left, int right) {
     }
 }
 
-void *parallel_merge_sort(void *arg) {
-    int id = (int)(long)arg;
-    int start = id * (SIZE / THREADS);
-    int end = (id + 1) * (SIZE / THREADS) - 1;
-    
-    merge_sort(start, end);
-    
+/* ---------------- fork-join 并行归并排序 ---------------- */
+
+typedef struct {
+    const int *a;
+    long na;
+    const int *b;
+    long nb;
+    int *dst;
+    int depth;
+} merge_args_t;
+
+typedef struct {
+    int *src;
+    int *tmp;
+    long n;
+    int to_tmp;                 // 结果写入 tmp（1）还是留在 src（0）
+    int depth;
+} sort_args_t;
+
+static void insertion_sort(int *a, long n) {
+    for (long i = 1; i < n; i++) {
+        int key = a[i];
+        long j = i - 1;
+        while (j >= 0 && a[j] > key) {
+            a[j + 1] = a[j];
+            j--;
+        }
+        a[j + 1] = key;
+    }
+}
+
+static void seq_merge(const int *a, long na, const int *b, long nb, int *dst) {
+    long i = 0, j = 0, k = 0;
+
+    while (i < na && j < nb) {
+        dst[k++] = a[i] <= b[j] ? a[i++] : b[j++];
+    }
+    while (i < na) {
+        dst[k++] = a[i++];
+    }
+    while (j < nb) {
+        dst[k++] = b[j++];
+    }
+}
+
+// 第一个不小于 key 的位置
+static long lower_bound(const int *a, long n, int key) {
+    long lo = 0, hi = n;
+
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (a[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void *parallel_merge_thread(void *arg);
+
+// 取较长序列的中点，在另一序列中二分查找切分点，两半互不重叠，可以并行合并
+static void parallel_merge(const int *a, long na, const int *b, long nb, int *dst, int depth) {
+    if (na < nb) {
+        const int *t = a;
+        long tn = na;
+        a = b;
+        na = nb;
+        b = t;
+        nb = tn;
+    }
+
+    if (na == 0) {
+        return;
+    }
+    if (depth <= 0 || na + nb <= MERGE_CUTOFF) {
+        seq_merge(a, na, b, nb, dst);
+        return;
+    }
+
+    long ma = na / 2;
+    long mb = lower_bound(b, nb, a[ma]);
+    dst[ma + mb] = a[ma];
+
+    pthread_t tid;
+    merge_args_t left = {a, ma, b, mb, dst, depth - 1};
+    int forked = pthread_create(&tid, NULL, parallel_merge_thread, &left) == 0;
+    if (!forked) {
+        parallel_merge(a, ma, b, mb, dst, 0);
+    }
+
+    parallel_merge(a + ma + 1, na - ma - 1, b + mb, nb - mb, dst + ma + mb + 1, depth - 1);
+
+    if (forked) {
+        pthread_join(tid, NULL);
+    }
+}
+
+static void *parallel_merge_thread(void *arg) {
+    merge_args_t *m = (merge_args_t *)arg;
+    parallel_merge(m->a, m->na, m->b, m->nb, m->dst, m->depth);
     return NULL;
 }
 
-int main() {
-    pthread_t threads[THREADS];
-    struct timespec start, end;
-    double time_parallel, time_sequential;
-    
+static void *parallel_sort_thread(void *arg);
+
+// 对 src[0..n) 排序，结果放在 src 或 tmp 中；两块缓冲区交替使用，整个排序只需一份辅助空间
+static void parallel_sort(int *src, int *tmp, long n, int to_tmp, int depth) {
+    if (n <= INSERTION_CUTOFF) {
+        insertion_sort(src, n);
+        if (to_tmp) {
+            memcpy(tmp, src, sizeof(int) * n);
+        }
+        return;
+    }
+
+    long half = n / 2;
+    sort_args_t left = {src, tmp, half, !to_tmp, depth - 1};
+    pthread_t tid;
+    int forked = 0;
+
+    // 两半排好后放到另一块缓冲区，再合并回目标缓冲区
+    if (depth > 0 && n > SORT_CUTOFF) {
+        forked = pthread_create(&tid, NULL, parallel_sort_thread, &left) == 0;
+    }
+    if (!forked) {
+        parallel_sort(src, tmp, half, !to_tmp, 0);
+    }
+
+    parallel_sort(src + half, tmp + half, n - half, !to_tmp, depth - 1);
+
+    if (forked) {
+        pthread_join(tid, NULL);
+    }
+
+    int *from = to_tmp ? src : tmp;
+    int *to = to_tmp ? tmp : src;
+    parallel_merge(from, half, from + half, n - half, to, depth);
+}
+
+static void *parallel_sort_thread(void *arg) {
+    sort_args_t *s = (sort_args_t *)arg;
+    parallel_sort(s->src, s->tmp, s->n, s->to_tmp, s->depth);
+    return NULL;
+}
+
+// 派生深度：叶子任务数约为线程数的 4 倍，便于负载均衡
+static int fork_depth(int threads) {
+    int depth = 0;
+    while ((1 << depth) < threads * 4) {
+        depth++;
+    }
+    return threads > 1 ? depth : 0;
+}
+
+void parallel_merge_sort(int threads) {
+    parallel_sort(array, scratch, size, 0, fork_depth(threads));
+}
+
+/* ---------------- 并行 LSD 基数排序 ---------------- */
+
+typedef struct {
+    uint64_t key;
+    uint64_t value;
+} kv_pair_t;
+
+typedef struct {
+    char *src;
+    char *dst;
+    long n;
+    int threads;
+    int passes;                 // 键的字节数，每个 pass 处理 8 位
+    int swaps;                  // 实际执行的 pass 数，奇数时结果在辅助缓冲区
+    int skip;                   // 当前 pass 所有元素落在同一个桶，可以跳过
+    pthread_barrier_t barrier;
+    pthread_mutex_t start_lock; // 实际创建出的线程数确定之后，各线程才开始划分数据
+    pthread_cond_t start_cond;
+    int started;
+    long (*count)[RADIX_BUCKETS];   // count[t][b]：线程 t 的直方图，前缀和后变成写入起点
+    void (*histogram)(const void *src, long begin, long end, int shift, long *count);
+    void (*scatter)(const void *src, void *dst, long begin, long end, int shift, long *offset);
+} radix_ctx_t;
+
+typedef struct {
+    radix_ctx_t *ctx;
+    int id;
+} radix_worker_t;
+
+// 按类型生成直方图与分发内核；分发先写入每桶一个缓存行大小的写合并缓冲区，满了再整行拷贝到目标位置
+#define DEFINE_RADIX_KERNELS(NAME, TYPE, KEY)                                           \
+static void NAME##_histogram(const void *src, long begin, long end, int shift,          \
+                             long *count) {                                             \
+    const TYPE *a = (const TYPE *)src;                                                  \
+    for (long i = begin; i < end; i++) {                                                \
+        count[(KEY(a[i]) >> shift) & (RADIX_BUCKETS - 1)]++;                            \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static void NAME##_scatter(const void *src, void *dst, long begin, long end, int shift, \
+                           long *offset) {                                              \
+    enum { WC = WC_BYTES / sizeof(TYPE) };                                              \
+    const TYPE *a = (const TYPE *)src;                                                  \
+    TYPE *out = (TYPE *)dst;                                                            \
+    TYPE buf[RADIX_BUCKETS][WC];                                                        \
+    int fill[RADIX_BUCKETS] = {0};                                                      \
+                                                                                        \
+    for (long i = begin; i < end; i++) {                                                \
+        int b = (int)((KEY(a[i]) >> shift) & (RADIX_BUCKETS - 1));                      \
+        buf[b][fill[b]++] = a[i];                                                       \
+        if (fill[b] == WC) {                                                            \
+            memcpy(out + offset[b], buf[b], sizeof(buf[b]));                            \
+            offset[b] += WC;                                                            \
+            fill[b] = 0;                                                                \
+        }                                                                               \
+    }                                                                                   \
+    for (int b = 0; b < RADIX_BUCKETS; b++) {                                           \
+        memcpy(out + offset[b], buf[b], sizeof(TYPE) * fill[b]);                        \
+        offset[b] += fill[b];                                                           \
+    }                                                                                   \
+}
+
+#define KEY_U32(x) ((uint32_t)(x))
+#define KEY_I32(x) ((uint32_t)(x) ^ 0x80000000u)    // 翻转符号位，负数排在前面
+#define KEY_U64(x) ((uint64_t)(x))
+#define KEY_KV(x) ((x).key)
+
+DEFINE_RADIX_KERNELS(radix_u32, uint32_t, KEY_U32)
+DEFINE_RADIX_KERNELS(radix_i32, int32_t, KEY_I32)
+DEFINE_RADIX_KERNELS(radix_u64, uint64_t, KEY_U64)
+DEFINE_RADIX_KERNELS(radix_kv, kv_pair_t, KEY_KV)
+
+static void *radix_worker(void *arg) {
+    radix_worker_t *w = (radix_worker_t *)arg;
+    radix_ctx_t *ctx = w->ctx;
+
+    pthread_mutex_lock(&ctx->start_lock);
+    while (!ctx->started) {
+        pthread_cond_wait(&ctx->start_cond, &ctx->start_lock);
+    }
+    pthread_mutex_unlock(&ctx->start_lock);
+
+    long chunk = (ctx->n + ctx->threads - 1) / ctx->threads;
+    long begin = w->id * chunk;
+    long end = begin + chunk < ctx->n ? begin + chunk : ctx->n;
+    char *src = ctx->src, *dst = ctx->dst;
+
+    if (begin > end) {
+        begin = end;
+    }
+
+    for (int pass = 0; pass < ctx->passes; pass++) {
+        int shift = pass * RADIX_BITS;
+        long *count = ctx->count[w->id];
+
+        // 1. 每个线程统计自己那一段的直方图
+        memset(count, 0, sizeof(long) * RADIX_BUCKETS);
+        ctx->histogram(src, begin, end, shift, count);
+        pthread_barrier_wait(&ctx->barrier);
+
+        // 2. 前缀和：桶 b 中线程 t 的起点 = 所有更小桶的总数 + 线程 0..t-1 在桶 b 中的数量
+        if (w->id == 0) {
+            long base = 0;
+            ctx->skip = 0;
+            for (int b = 0; b < RADIX_BUCKETS; b++) {
+                long total = 0;
+                for (int t = 0; t < ctx->threads; t++) {
+                    long c = ctx->count[t][b];
+                    ctx->count[t][b] = base + total;
+                    total += c;
+                }
+                if (total == ctx->n) {
+                    ctx->skip = 1;
+                }
+                base += total;
+            }
+            if (!ctx->skip) {
+                ctx->swaps++;
+            }
+        }
+        pthread_barrier_wait(&ctx->barrier);
+
+        // 3. 各线程把自己那一段分发到互不重叠的目标区间
+        if (ctx->skip) {
+            continue;
+        }
+        ctx->scatter(src, dst, begin, end, shift, count);
+        pthread_barrier_wait(&ctx->barrier);
+
+        char *t = src;
+        src = dst;
+        dst = t;
+    }
+    return NULL;
+}
+
+static void radix_sort_run(radix_ctx_t *ctx, size_t elem_size, int threads) {
+    long max_threads = ctx->n / RADIX_MIN_PER_THREAD + 1;
+    char *a = ctx->src;
+
+    ctx->threads = threads < max_threads ? threads : (int)max_threads;
+    ctx->swaps = 0;
+    ctx->count = malloc(sizeof(*ctx->count) * ctx->threads);
+    pthread_t *tids = malloc(sizeof(pthread_t) * ctx->threads);
+    radix_worker_t *workers = malloc(sizeof(radix_worker_t) * ctx->threads);
+    if (ctx->count == NULL || tids == NULL || workers == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    // 线程数和屏障的计数必须一致，所以先创建线程、让它们等待，创建失败就按实际创建出的线程数划分
+    pthread_mutex_init(&ctx->start_lock, NULL);
+    pthread_cond_init(&ctx->start_cond, NULL);
+    ctx->started = 0;
+    int created = 1;
+    for (int t = 0; t < ctx->threads; t++) {
+        workers[t].ctx = ctx;
+        workers[t].id = t;
+        if (t > 0) {
+            if (pthread_create(&tids[t], NULL, radix_worker, &workers[t]) != 0) {
+                break;
+            }
+            created++;
+        }
+    }
+    pthread_mutex_lock(&ctx->start_lock);
+    ctx->threads = created;
+    pthread_barrier_init(&ctx->barrier, NULL, ctx->threads);
+    ctx->started = 1;
+    pthread_cond_broadcast(&ctx->start_cond);
+    pthread_mutex_unlock(&ctx->start_lock);
+
+    radix_worker(&workers[0]);
+    for (int t = 1; t < ctx->threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+
+    // 奇数次分发后结果在辅助缓冲区，拷回原数组
+    if (ctx->swaps % 2 == 1) {
+        memcpy(a, ctx->dst, elem_size * ctx->n);
+    }
+
+    pthread_barrier_destroy(&ctx->barrier);
+    pthread_cond_destroy(&ctx->start_cond);
+    pthread_mutex_destroy(&ctx->start_lock);
+    free(ctx->count);
+    free(tids);
+    free(workers);
+}
+
+static void radix_sort(void *a, void *tmp, long n, size_t elem_size, int key_bytes,
+                       int threads,
+                       void (*histogram)(const void *, long, long, int, long *),
+                       void (*scatter)(const void *, void *, long, long, int, long *)) {
+    radix_ctx_t ctx;
+
+    ctx.src = (char *)a;
+    ctx.dst = (char *)tmp;
+    ctx.n = n;
+    ctx.passes = key_bytes * 8 / RADIX_BITS;
+    ctx.histogram = histogram;
+    ctx.scatter = scatter;
+    radix_sort_run(&ctx, elem_size, threads);
+}
+
+// 以下排序函数的 tmp 是与 a 等长的辅助缓冲区，结果写回 a
+void radix_sort_u32(uint32_t *a, uint32_t *tmp, long n, int threads) {
+    radix_sort(a, tmp, n, sizeof(uint32_t), 4, threads, radix_u32_histogram, radix_u32_scatter);
+}
+
+void radix_sort_i32(int32_t *a, int32_t *tmp, long n, int threads) {
+    radix_sort(a, tmp, n, sizeof(int32_t), 4, threads, radix_i32_histogram, radix_i32_scatter);
+}
+
+void radix_sort_u64(uint64_t *a, uint64_t *tmp, long n, int threads) {
+    radix_sort(a, tmp, n, sizeof(uint64_t), 8, threads, radix_u64_histogram, radix_u64_scatter);
+}
+
+// 按 key 排序键值对，键相同的元素保持原有顺序（LSD 基数排序是稳定的）
+void radix_sort_kv(kv_pair_t *a, kv_pair_t *tmp, long n, int threads) {
+    radix_sort(a, tmp, n, sizeof(kv_pair_t), 8, threads, radix_kv_histogram, radix_kv_scatter);
+}
+
+static int is_sorted(const int *a, long n) {
+    for (long i = 1; i < n; i++) {
+        if (a[i - 1] > a[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* ---------------- 基准测试 ---------------- */
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint64_t xorshift64(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 计时区间的开始与结束，同时采集性能计数器
+static double region_begin(void) {
+    perf_counters_start(&perf);
+    return now_sec();
+}
+
+static double region_end(double start) {
+    double t = now_sec() - start;
+    perf_counters_stop(&perf);
+    return t;
+}
+
+static int cmp_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static int is_sorted_u64(const uint64_t *a, long n) {
+    for (long i = 1; i < n; i++) {
+        if (a[i - 1] > a[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int is_sorted_kv(const kv_pair_t *a, long n) {
+    for (long i = 1; i < n; i++) {
+        // value 记录原始下标，键相同时应保持递增（稳定性）
+        if (a[i - 1].key > a[i].key ||
+            (a[i - 1].key == a[i].key && a[i - 1].value > a[i].value)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 按可用物理内存判断能否放下 bytes 字节，避免大尺寸下触发 OOM
+static int fits_memory(double bytes) {
+    long pages = sysconf(_SC_AVPHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || page_size <= 0) {
+        return 1;
+    }
+    return bytes < (double)pages * page_size * 0.9;
+}
+
+#define BENCH_COLUMNS 6
+
+// 当前行各列的 IPC 与每个元素的 LLC 未命中数，整行打印完后再输出
+static double row_ipc[BENCH_COLUMNS], row_llc[BENCH_COLUMNS];
+static int row_cells;
+
+static void print_cell(double seconds, int ok, long n) {
+    if (seconds < 0) {
+        printf(" %12s", "内存不足");
+        row_ipc[row_cells] = row_llc[row_cells] = NAN;
+    } else {
+        printf(" %11.3fs%s", seconds, ok ? "" : "!");
+        row_ipc[row_cells] = perf_counters_ipc(&perf);
+        row_llc[row_cells] = perf_counters_per_op(&perf, PERF_LLC_MISSES, n);
+    }
+    row_cells++;
+}
+
+static void print_perf_rows(void) {
+    printf("%10s", "IPC");
+    for (int c = 0; c < row_cells; c++) {
+        isnan(row_ipc[c]) ? printf(" %12s", "-") : printf(" %12.2f", row_ipc[c]);
+    }
+    printf("\n%10s", "LLC/元素");
+    for (int c = 0; c < row_cells; c++) {
+        isnan(row_llc[c]) ? printf(" %12s", "-") : printf(" %12.4f", row_llc[c]);
+    }
+    printf("\n");
+    row_cells = 0;
+}
+
+// 顺序归并、qsort、并行归并、基数排序（int32 / uint64 / 键值对），每种排序都使用同一份随机数据
+static void bench_sort(long max_size, int threads) {
+    static const long sizes[] = {10000, 100000, 1000000, 10000000, 100000000, 500000000};
+    int errors = 0;
+
+    printf("线程数: %d，时间单位为秒，! 表示结果未排好序；每个规模下附 IPC 和每元素 LLC 未命中\n",
+           threads);
+    printf("%10s %12s %12s %12s %12s %12s %12s\n", "元素个数", "merge_sort", "qsort",
+           "并行归并", "基数 i32", "基数 u64", "基数 kv");
+
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]) && sizes[k] <= max_size; k++) {
+        long n = sizes[k];
+        double t;
+        int ok;
+
+        printf("%10ld", n);
+        fflush(stdout);
+
+        // 32 位整数：原始数据 + 工作数组 + 辅助缓冲区
+        int *data = fits_memory(3.0 * sizeof(int) * n) ? malloc(sizeof(int) * n) : NULL;
+        array = data ? malloc(sizeof(int) * n) : NULL;
+        scratch = array ? malloc(sizeof(int) * n) : NULL;
+        if (scratch == NULL) {
+            for (int c = 0; c < 4; c++) {
+                print_cell(-1, 0, n);
+            }
+        } else {
+            size = n;
+            for (long i = 0; i < n; i++) {
+                data[i] = (int)xorshift64();
+            }
+
+            memcpy(array, data, sizeof(int) * n);
+            t = region_begin();
+            merge_sort(0, (int)(n - 1));
+            t = region_end(t);
+            ok = is_sorted(array, n);
+            errors += !ok;
+            print_cell(t, ok, n);
+            fflush(stdout);
+
+            memcpy(array, data, sizeof(int) * n);
+            t = region_begin();
+            qsort(array, n, sizeof(int), cmp_int);
+            t = region_end(t);
+            ok = is_sorted(array, n);
+            errors += !ok;
+            print_cell(t, ok, n);
+            fflush(stdout);
+
+            memcpy(array, data, sizeof(int) * n);
+            t = region_begin();
+            parallel_merge_sort(threads);
+            t = region_end(t);
+            ok = is_sorted(array, n);
+            errors += !ok;
+            print_cell(t, ok, n);
+            fflush(stdout);
+
+            memcpy(array, data, sizeof(int) * n);
+            t = region_begin();
+            radix_sort_i32((int32_t *)array, (int32_t *)scratch, n, threads);
+            t = region_end(t);
+            ok = is_sorted(array, n);
+            errors += !ok;
+            print_cell(t, ok, n);
+            fflush(stdout);
+        }
+        free(data);
+        free(array);
+        free(scratch);
+        array = scratch = NULL;
+
+        // 64 位整数
+        uint64_t *u = fits_memory(2.0 * sizeof(uint64_t) * n) ? malloc(sizeof(uint64_t) * n) : NULL;
+        uint64_t *utmp = u ? malloc(sizeof(uint64_t) * n) : NULL;
+        if (utmp == NULL) {
+            print_cell(-1, 0, n);
+        } else {
+            for (long i = 0; i < n; i++) {
+                u[i] = xorshift64();
+            }
+            t = region_begin();
+            radix_sort_u64(u, utmp, n, threads);
+            t = region_end(t);
+            ok = is_sorted_u64(u, n);
+            errors += !ok;
+            print_cell(t, ok, n);
+            fflush(stdout);
+        }
+        free(u);
+        free(utmp);
+
+        // 键值对：键只取 16 位，制造大量重复键以检查稳定性
+        kv_pair_t *kv = fits_memory(2.0 * sizeof(kv_pair_t) * n) ? malloc(sizeof(kv_pair_t) * n) : NULL;
+        kv_pair_t *kvtmp = kv ? malloc(sizeof(kv_pair_t) * n) : NULL;
+        if (kvtmp == NULL) {
+            print_cell(-1, 0, n);
+        } else {
+            for (long i = 0; i < n; i++) {
+                kv[i].key = xorshift64() & 0xffff;
+                kv[i].value = (uint64_t)i;
+            }
+            t = region_begin();
+            radix_sort_kv(kv, kvtmp, n, threads);
+            t = region_end(t);
+            ok = is_sorted_kv(kv, n);
+            errors += !ok;
+            print_cell(t, ok, n);
+        }
+        free(kv);
+        free(kvtmp);
+        printf("\n");
+        print_perf_rows();
+    }
+
+    if (errors > 0) {
+        printf("有 %d 项排序结果错误!\n", errors);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    double time_parallel, time_sequential, time_radix;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 0 ? (int)cpus : THREADS;
+
+    // 计数器不可用时各项显示为 "-"，计时不受影响
+    perf_counters_open(&perf);
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        long max_size = argc > 2 ? atol(argv[2]) : SIZE;
+        if (argc > 3) {
+            threads = atoi(argv[3]);
+        }
+        if (max_size < 1 || max_size > 0x7fffffff || threads < 1) {
+            fprintf(stderr, "用法: %s bench [最大元素个数] [线程数]\n", argv[0]);
+            return 1;
+        }
+        bench_sort(max_size, threads);
+        perf_counters_close(&perf);
+        return 0;
+    }
+
+    if (argc > 1) {
+        size = atol(argv[1]);
+    }
+    if (argc > 2) {
+        threads = atoi(argv[2]);
+    }
+    if (size < 1 || size > 0x7fffffff || threads < 1) {
+        fprintf(stderr, "用法: %s [元素个数] [线程数] | bench [最大元素个数] [线程数]\n", argv[0]);
+        return 1;
+    }
+
+    array = malloc(sizeof(int) * size);
+    scratch = malloc(sizeof(int) * size);
+    if (array == NULL || scratch == NULL) {
+        perror("malloc");
+        return 1;
+    }
+
     // 初始化数组
     srand(time(NULL));
-    for (int i = 0; i < SIZE; i++) {
-        array[i] = rand() % 10000;
+    for (long i = 0; i < size; i++) {
+        array[i] = rand();
     }
-    
+
     // 并行排序
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    
-    for (int i = 0; i < THREADS; i++) {
-        pthread_create(&threads[i], NULL, parallel_merge_sort, (void *)(long)i);
-    }
-    
-    for (int i = 0; i < THREADS; i++) {
-        pthread_join(threads[i], NULL);
-    }
-    
-    // 合并结果
-    for (int i = 1; i < THREADS; i++) {
-        merge(0, i * (SIZE / THREADS) - 1, (i + 1) * (SIZE / THREADS) - 1);
-    }
-    
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    time_parallel = (end.tv_sec - start.tv_sec) + 
-                    (end.tv_nsec - start.tv_nsec) / 1e9;
-    
-    printf("并行排序: %.3f 秒\n", time_parallel);
-    
+    time_parallel = region_begin();
+    parallel_merge_sort(threads);
+    time_parallel = region_end(time_parallel);
+
+    printf("并行排序: %.3f 秒 (%ld 个元素, %d 线程, 派生深度 %d)%s\n", time_parallel, size,
+           threads, fork_depth(threads), is_sorted(array, size) ? "" : " 结果错误!");
+    perf_counters_print(&perf, "并行排序", size);
+
     // 重新初始化数组
-    for (int i = 0; i < SIZE; i++) {
-        array[i] = rand() % 10000;
+    for (long i = 0; i < size; i++) {
+        array[i] = rand();
     }
-    
+
     // 顺序排序
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    merge_sort(0, SIZE - 1);
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    time_sequential = (end.tv_sec - start.tv_sec) + 
-                     (end.tv_nsec - start.tv_nsec) / 1e9;
-    
-    printf("顺序排序: %.3f 秒\n", time_sequential);
+    time_sequential = region_begin();
+    merge_sort(0, size - 1);
+    time_sequential = region_end(time_sequential);
+
+    printf("顺序排序: %.3f 秒%s\n", time_sequential,
+           is_sorted(array, size) ? "" : " 结果错误!");
+    perf_counters_print(&perf, "顺序排序", size);
     printf("加速比: %.2fx\n", time_sequential / time_parallel);
-    
+
+    // 基数排序（同样规模的随机数据）
+    for (long i = 0; i < size; i++) {
+        array[i] = rand();
+    }
+    time_radix = region_begin();
+    radix_sort_i32((int32_t *)array, (int32_t *)scratch, size, threads);
+    time_radix = region_end(time_radix);
+    printf("基数排序: %.3f 秒%s\n", time_radix, is_sorted(array, size) ? "" : " 结果错误!");
+    perf_counters_print(&perf, "基数排序", size);
+
+    free(array);
+    free(scratch);
+    perf_counters_close(&perf);
+
     return 0;
-}
\ No newline at end of file
+}
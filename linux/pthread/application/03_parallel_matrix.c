@@ -1,87 +1,599 @@
 #include <stdio.h>
+#include <math.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+#include "perf_counters.h"
 
 #define SIZE 1000
 #define THREADS 4
 
-int matrix_a[SIZE][SIZE];
-int matrix_b[SIZE][SIZE];
-int matrix_c[SIZE][SIZE];
+// 分块参数：微内核计算 MR×NR 的 C 子块，NR 固定为一个缓存行的元素个数
+// 输出按 TILE_M×TILE_N 切成二维瓦片，瓦片内公共维度按 KC 分段打包
+#define MR 6
+#define NR_OF(T) (64 / (int)sizeof(T))
+#define KC 256
+#define TILE_M 96
+#define TILE_N 256
+
+typedef enum {
+    ELEM_I32,
+    ELEM_F32,
+    ELEM_F64,
+    ELEM_TYPES
+} elem_type_t;
+
+typedef enum {
+    KERNEL_SCALAR,
+    KERNEL_AVX2,
+    KERNEL_AVX512,
+    KERNEL_LEVELS
+} kernel_level_t;
+
+static const char *kernel_names[KERNEL_LEVELS] = {"scalar", "avx2", "avx512"};
+
+static perf_counters_t perf;    // run_gemm 每次运行都会重新采集
+
+// 行优先的堆上矩阵
+typedef struct {
+    elem_type_t type;
+    long rows;
+    long cols;
+    void *data;
+} matrix_t;
+
+// 微内核：c[MR][NR] += Apack(MR×kc) * Bpack(kc×NR)，ldc 为 c 的行跨度（元素个数）
+typedef void (*micro_kernel_t)(long kc, const void *a, const void *b, void *c, long ldc);
+
+typedef enum {
+    SCHED_STATIC,               // 每个线程固定分到一段连续瓦片
+    SCHED_DYNAMIC               // 线程从原子计数器领取下一个瓦片
+} sched_mode_t;
+
+typedef struct gemm_ctx gemm_ctx_t;
+
+typedef struct {
+    const char *name;
+    size_t size;
+    void (*naive)(const matrix_t *a, const matrix_t *b, matrix_t *c, long m0, long m1);
+    void (*tile)(gemm_ctx_t *ctx, long tile, void *apack, void *bpack);
+    void (*fill)(matrix_t *m);
+    int (*equal)(const matrix_t *x, const matrix_t *y);
+    micro_kernel_t micro[KERNEL_LEVELS];    // 不支持的级别为 NULL
+} elem_ops_t;
+
+struct gemm_ctx {
+    const matrix_t *a;
+    const matrix_t *b;
+    matrix_t *c;
+    const elem_ops_t *ops;
+    micro_kernel_t micro;
+    sched_mode_t sched;
+    int threads;
+    long tiles_m;
+    long tiles_n;
+    long next_tile;             // 动态调度的原子计数器
+};
 
 typedef struct {
-    int start_row;
-    int end_row;
+    gemm_ctx_t *ctx;
+    int id;
+    long start_row;
+    long end_row;
 } thread_data_t;
 
-void *multiply(void *arg) {
-    thread_data_t *data = (thread_data_t *)arg;
-    
-    for (int i = data->start_row; i < data->end_row; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            matrix_c[i][j] = 0;
-            for (int k = 0; k < SIZE; k++) {
-                matrix_c[i][j] += matrix_a[i][k] * matrix_b[k][j];
+/* ---------------- 按元素类型生成的标量代码 ---------------- */
+
+// 朴素 i-j-k 版本保留作为基线：B 按列访问，几乎每次内层迭代都是缓存未命中
+#define DEFINE_GEMM_TYPE(S, T, RANDOM, EQUAL)                                           \
+static void naive_##S(const matrix_t *ma, const matrix_t *mb, matrix_t *mc, long m0,    \
+                      long m1) {                                                        \
+    const T *a = ma->data, *b = mb->data;                                               \
+    T *c = mc->data;                                                                    \
+    long n = mc->cols, k = ma->cols;                                                    \
+    for (long i = m0; i < m1; i++) {                                                    \
+        for (long j = 0; j < n; j++) {                                                  \
+            c[i * n + j] = 0;                                                           \
+            for (long p = 0; p < k; p++) {                                              \
+                c[i * n + j] += a[i * k + p] * b[p * n + j];                            \
+            }                                                                           \
+        }                                                                               \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static void micro_scalar_##S(long kc, const void *ap, const void *bp, void *cp,        \
+                             long ldc) {                                                \
+    const T *a = ap, *b = bp;                                                           \
+    T *c = cp;                                                                          \
+    T acc[MR][NR_OF(T)];                                                                \
+    memset(acc, 0, sizeof(acc));                                                        \
+    for (long p = 0; p < kc; p++) {                                                     \
+        for (int i = 0; i < MR; i++) {                                                  \
+            T ai = a[p * MR + i];                                                       \
+            for (int j = 0; j < NR_OF(T); j++) {                                        \
+                acc[i][j] += ai * b[p * NR_OF(T) + j];                                  \
+            }                                                                           \
+        }                                                                               \
+    }                                                                                   \
+    for (int i = 0; i < MR; i++) {                                                      \
+        for (int j = 0; j < NR_OF(T); j++) {                                            \
+            c[i * ldc + j] += acc[i][j];                                                \
+        }                                                                               \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+/* 把 A 的 mc×kc 子块按 MR 行一条打包成列优先面板，不足 MR 行补 0 */                     \
+static void pack_a_##S(const T *a, long lda, long mc, long kc, T *dst) {                \
+    for (long ir = 0; ir < mc; ir += MR) {                                              \
+        for (long p = 0; p < kc; p++) {                                                 \
+            for (int i = 0; i < MR; i++) {                                              \
+                *dst++ = ir + i < mc ? a[(ir + i) * lda + p] : 0;                       \
+            }                                                                           \
+        }                                                                               \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+/* 把 B 的 kc×nc 子块按 NR 列一条打包成行优先面板，不足 NR 列补 0 */                     \
+static void pack_b_##S(const T *b, long ldb, long kc, long nc, T *dst) {                \
+    for (long jr = 0; jr < nc; jr += NR_OF(T)) {                                        \
+        for (long p = 0; p < kc; p++) {                                                 \
+            for (int j = 0; j < NR_OF(T); j++) {                                        \
+                *dst++ = jr + j < nc ? b[p * ldb + jr + j] : 0;                         \
+            }                                                                           \
+        }                                                                               \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+/* 计算一个输出瓦片 C[i0..i0+mc, j0..j0+nc) */                                          \
+static void tile_##S(gemm_ctx_t *ctx, long tile, void *apack, void *bpack) {           \
+    enum { NR = NR_OF(T) };                                                             \
+    const T *a = ctx->a->data, *b = ctx->b->data;                                       \
+    T *c = ctx->c->data;                                                                \
+    long n = ctx->c->cols, k = ctx->a->cols;                                            \
+    long i0 = tile / ctx->tiles_n * TILE_M, j0 = tile % ctx->tiles_n * TILE_N;          \
+    long mc = ctx->c->rows - i0 < TILE_M ? ctx->c->rows - i0 : TILE_M;                  \
+    long nc = n - j0 < TILE_N ? n - j0 : TILE_N;                                        \
+                                                                                        \
+    for (long i = 0; i < mc; i++) {                                                     \
+        memset(c + (i0 + i) * n + j0, 0, sizeof(T) * nc);                               \
+    }                                                                                   \
+    for (long pc = 0; pc < k; pc += KC) {                                               \
+        long kc = k - pc < KC ? k - pc : KC;                                            \
+        pack_b_##S(b + pc * n + j0, n, kc, nc, bpack);                                  \
+        pack_a_##S(a + i0 * k + pc, k, mc, kc, apack);                                  \
+        for (long jr = 0; jr < nc; jr += NR) {                                          \
+            for (long ir = 0; ir < mc; ir += MR) {                                      \
+                const T *ap = (const T *)apack + ir * kc;                               \
+                const T *bp = (const T *)bpack + jr * kc;                               \
+                T *cp = c + (i0 + ir) * n + j0 + jr;                                    \
+                if (ir + MR <= mc && jr + NR <= nc) {                                   \
+                    ctx->micro(kc, ap, bp, cp, n);                                      \
+                } else {                                                                \
+                    /* 边缘子块先算到临时缓冲区，再只写回有效部分 */                      \
+                    T tmp[MR * NR];                                                     \
+                    memset(tmp, 0, sizeof(tmp));                                        \
+                    ctx->micro(kc, ap, bp, tmp, NR);                                    \
+                    for (long i = 0; i < MR && ir + i < mc; i++) {                      \
+                        for (long j = 0; j < NR && jr + j < nc; j++) {                  \
+                            cp[i * n + j] += tmp[i * NR + j];                           \
+                        }                                                               \
+                    }                                                                   \
+                }                                                                       \
+            }                                                                           \
+        }                                                                               \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static void fill_##S(matrix_t *m) {                                                     \
+    T *d = m->data;                                                                     \
+    for (long i = 0; i < m->rows * m->cols; i++) {                                      \
+        d[i] = RANDOM;                                                                  \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static int equal_##S(const matrix_t *x, const matrix_t *y) {                            \
+    const T *a = x->data, *b = y->data;                                                 \
+    for (long i = 0; i < x->rows * x->cols; i++) {                                      \
+        if (!EQUAL(a[i], b[i])) {                                                       \
+            return 0;                                                                   \
+        }                                                                               \
+    }                                                                                   \
+    return 1;                                                                           \
+}
+
+// 浮点结果因累加顺序不同会有舍入差异，按相对误差比较
+#define EQUAL_EXACT(x, y) ((x) == (y))
+#define EQUAL_F32(x, y) (((x) - (y)) * ((x) - (y)) <= 1e-8f * ((x) * (x) + 1.0f))
+#define EQUAL_F64(x, y) (((x) - (y)) * ((x) - (y)) <= 1e-20 * ((x) * (x) + 1.0))
+
+DEFINE_GEMM_TYPE(i32, int, rand() % 100, EQUAL_EXACT)
+DEFINE_GEMM_TYPE(f32, float, (float)rand() / RAND_MAX, EQUAL_F32)
+DEFINE_GEMM_TYPE(f64, double, (double)rand() / RAND_MAX, EQUAL_F64)
+
+/* ---------------- SIMD 微内核 ---------------- */
+
+#ifdef HAVE_X86_SIMD
+// 每行两个向量累加器（AVX2），共 12 个，加上两个 B 向量和一个广播寄存器正好放进 16 个 ymm
+#define ROW2(FMA, SET1, i)                                  \
+    c##i##0 = FMA(SET1(a[p * MR + (i)]), b0, c##i##0);      \
+    c##i##1 = FMA(SET1(a[p * MR + (i)]), b1, c##i##1)
+
+#define STORE2(LOAD, STORE, ADD, LANES, i)                                      \
+    STORE(c + (i) * ldc, ADD(LOAD(c + (i) * ldc), c##i##0));                    \
+    STORE(c + (i) * ldc + (LANES), ADD(LOAD(c + (i) * ldc + (LANES)), c##i##1))
+
+#define DEFINE_SIMD2_KERNEL(NAME, TARGET, T, VT, LANES, ZERO, LOAD, STORE, SET1, FMA, ADD) \
+__attribute__((target(TARGET)))                                                        \
+static void NAME(long kc, const void *ap, const void *bp, void *cp, long ldc) {        \
+    const T *a = ap, *b = bp;                                                          \
+    T *c = cp;                                                                         \
+    VT c00 = ZERO(), c01 = ZERO(), c10 = ZERO(), c11 = ZERO();                         \
+    VT c20 = ZERO(), c21 = ZERO(), c30 = ZERO(), c31 = ZERO();                         \
+    VT c40 = ZERO(), c41 = ZERO(), c50 = ZERO(), c51 = ZERO();                         \
+    for (long p = 0; p < kc; p++) {                                                    \
+        VT b0 = LOAD(b + p * 2 * (LANES));                                             \
+        VT b1 = LOAD(b + p * 2 * (LANES) + (LANES));                                   \
+        ROW2(FMA, SET1, 0);                                                            \
+        ROW2(FMA, SET1, 1);                                                            \
+        ROW2(FMA, SET1, 2);                                                            \
+        ROW2(FMA, SET1, 3);                                                            \
+        ROW2(FMA, SET1, 4);                                                            \
+        ROW2(FMA, SET1, 5);                                                            \
+    }                                                                                  \
+    STORE2(LOAD, STORE, ADD, LANES, 0);                                                \
+    STORE2(LOAD, STORE, ADD, LANES, 1);                                                \
+    STORE2(LOAD, STORE, ADD, LANES, 2);                                                \
+    STORE2(LOAD, STORE, ADD, LANES, 3);                                                \
+    STORE2(LOAD, STORE, ADD, LANES, 4);                                                \
+    STORE2(LOAD, STORE, ADD, LANES, 5);                                                \
+}
+
+// AVX-512：NR 正好是一个 zmm，每行一个累加器
+#define ROW1(FMA, SET1, i) c##i = FMA(SET1(a[p * MR + (i)]), b0, c##i)
+#define STORE1(LOAD, STORE, ADD, i) STORE(c + (i) * ldc, ADD(LOAD(c + (i) * ldc), c##i))
+
+#define DEFINE_SIMD1_KERNEL(NAME, TARGET, T, VT, LANES, ZERO, LOAD, STORE, SET1, FMA, ADD) \
+__attribute__((target(TARGET)))                                                        \
+static void NAME(long kc, const void *ap, const void *bp, void *cp, long ldc) {        \
+    const T *a = ap, *b = bp;                                                          \
+    T *c = cp;                                                                         \
+    VT c0 = ZERO(), c1 = ZERO(), c2 = ZERO(), c3 = ZERO(), c4 = ZERO(), c5 = ZERO();   \
+    for (long p = 0; p < kc; p++) {                                                    \
+        VT b0 = LOAD(b + p * (LANES));                                                 \
+        ROW1(FMA, SET1, 0);                                                            \
+        ROW1(FMA, SET1, 1);                                                            \
+        ROW1(FMA, SET1, 2);                                                            \
+        ROW1(FMA, SET1, 3);                                                            \
+        ROW1(FMA, SET1, 4);                                                            \
+        ROW1(FMA, SET1, 5);                                                            \
+    }                                                                                  \
+    STORE1(LOAD, STORE, ADD, 0);                                                       \
+    STORE1(LOAD, STORE, ADD, 1);                                                       \
+    STORE1(LOAD, STORE, ADD, 2);                                                       \
+    STORE1(LOAD, STORE, ADD, 3);                                                       \
+    STORE1(LOAD, STORE, ADD, 4);                                                       \
+    STORE1(LOAD, STORE, ADD, 5);                                                       \
+}
+
+// 整数没有乘加指令，用 mullo + add 代替
+#define LOAD_I256(p) _mm256_loadu_si256((const __m256i *)(p))
+#define STORE_I256(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#define FMA_I256(x, y, z) _mm256_add_epi32(z, _mm256_mullo_epi32(x, y))
+#define FMA_I512(x, y, z) _mm512_add_epi32(z, _mm512_mullo_epi32(x, y))
+
+DEFINE_SIMD2_KERNEL(micro_avx2_i32, "avx2,fma", int, __m256i, 8, _mm256_setzero_si256,
+                    LOAD_I256, STORE_I256, _mm256_set1_epi32, FMA_I256, _mm256_add_epi32)
+DEFINE_SIMD2_KERNEL(micro_avx2_f32, "avx2,fma", float, __m256, 8, _mm256_setzero_ps,
+                    _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps, _mm256_fmadd_ps,
+                    _mm256_add_ps)
+DEFINE_SIMD2_KERNEL(micro_avx2_f64, "avx2,fma", double, __m256d, 4, _mm256_setzero_pd,
+                    _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, _mm256_fmadd_pd,
+                    _mm256_add_pd)
+DEFINE_SIMD1_KERNEL(micro_avx512_i32, "avx512f", int, __m512i, 16, _mm512_setzero_si512,
+                    _mm512_loadu_si512, _mm512_storeu_si512, _mm512_set1_epi32, FMA_I512,
+                    _mm512_add_epi32)
+DEFINE_SIMD1_KERNEL(micro_avx512_f32, "avx512f", float, __m512, 16, _mm512_setzero_ps,
+                    _mm512_loadu_ps, _mm512_storeu_ps, _mm512_set1_ps, _mm512_fmadd_ps,
+                    _mm512_add_ps)
+DEFINE_SIMD1_KERNEL(micro_avx512_f64, "avx512f", double, __m512d, 8, _mm512_setzero_pd,
+                    _mm512_loadu_pd, _mm512_storeu_pd, _mm512_set1_pd, _mm512_fmadd_pd,
+                    _mm512_add_pd)
+
+#define SIMD_KERNELS(S) micro_avx2_##S, micro_avx512_##S
+#else
+#define SIMD_KERNELS(S) NULL, NULL
+#endif
+
+static const elem_ops_t elem_ops[ELEM_TYPES] = {
+    [ELEM_I32] = {"i32", sizeof(int), naive_i32, tile_i32, fill_i32, equal_i32,
+                  {micro_scalar_i32, SIMD_KERNELS(i32)}},
+    [ELEM_F32] = {"f32", sizeof(float), naive_f32, tile_f32, fill_f32, equal_f32,
+                  {micro_scalar_f32, SIMD_KERNELS(f32)}},
+    [ELEM_F64] = {"f64", sizeof(double), naive_f64, tile_f64, fill_f64, equal_f64,
+                  {micro_scalar_f64, SIMD_KERNELS(f64)}},
+};
+
+static int kernel_supported(kernel_level_t level) {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    switch (level) {
+    case KERNEL_AVX512:
+        return __builtin_cpu_supports("avx512f");
+    case KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    default:
+        return 1;
+    }
+#else
+    return level == KERNEL_SCALAR;
+#endif
+}
+
+// 按名字选择内核级别；name 为 NULL 时选择 CPU 支持的最高级别
+static int select_kernel(const char *name) {
+    for (int level = KERNEL_LEVELS - 1; level >= 0; level--) {
+        if (name == NULL ? kernel_supported(level) : strcmp(name, kernel_names[level]) == 0) {
+            if (!kernel_supported(level)) {
+                fprintf(stderr, "CPU 不支持 %s 内核\n", name);
+                return -1;
             }
+            return level;
         }
     }
-    
+    fprintf(stderr, "未知内核: %s\n", name);
+    return -1;
+}
+
+/* ---------------- 矩阵与调度 ---------------- */
+
+static int matrix_create(matrix_t *m, elem_type_t type, long rows, long cols) {
+    m->type = type;
+    m->rows = rows;
+    m->cols = cols;
+    return posix_memalign(&m->data, 64, elem_ops[type].size * rows * cols) == 0 ? 0 : -1;
+}
+
+static void matrix_destroy(matrix_t *m) {
+    free(m->data);
+    m->data = NULL;
+}
+
+static void *multiply_naive(void *arg) {
+    thread_data_t *data = (thread_data_t *)arg;
+    gemm_ctx_t *ctx = data->ctx;
+
+    ctx->ops->naive(ctx->a, ctx->b, ctx->c, data->start_row, data->end_row);
     return NULL;
 }
 
-int main() {
-    pthread_t threads[THREADS];
-    thread_data_t data[THREADS];
-    struct timespec start, end;
-    double time_parallel, time_sequential;
-    
-    // 初始化矩阵
-    srand(time(NULL));
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            matrix_a[i][j] = rand() % 100;
-            matrix_b[i][j] = rand() % 100;
+static void *multiply_tiles(void *arg) {
+    thread_data_t *data = (thread_data_t *)arg;
+    gemm_ctx_t *ctx = data->ctx;
+    long total = ctx->tiles_m * ctx->tiles_n;
+    void *apack, *bpack;
+
+    // 打包缓冲区按缓存行对齐，每个线程独占一份；分不到就没法计算这个线程的分块，结果会缺一部分
+    if (posix_memalign(&apack, 64, ctx->ops->size * TILE_M * KC) != 0 ||
+        posix_memalign(&bpack, 64, ctx->ops->size * KC * TILE_N) != 0) {
+        perror("posix_memalign");
+        exit(1);
+    }
+
+    if (ctx->sched == SCHED_DYNAMIC) {
+        long tile;
+        while ((tile = __atomic_fetch_add(&ctx->next_tile, 1, __ATOMIC_RELAXED)) < total) {
+            ctx->ops->tile(ctx, tile, apack, bpack);
+        }
+    } else {
+        long begin = total * data->id / ctx->threads;
+        long end = total * (data->id + 1) / ctx->threads;
+        for (long tile = begin; tile < end; tile++) {
+            ctx->ops->tile(ctx, tile, apack, bpack);
         }
     }
-    
-    // 并行乘法
+
+    free(apack);
+    free(bpack);
+    return NULL;
+}
+
+// 用 threads 个线程计算 c = a * b，返回耗时（秒）
+static double run_gemm(gemm_ctx_t *ctx, void *(*fn)(void *), int threads) {
+    pthread_t *tids = malloc(sizeof(pthread_t) * threads);
+    char *started = calloc(threads, 1);
+    thread_data_t *data = malloc(sizeof(thread_data_t) * threads);
+    long m = ctx->c->rows;
+    struct timespec start, end;
+
+    if (tids == NULL || started == NULL || data == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    ctx->threads = threads;
+    ctx->tiles_m = (m + TILE_M - 1) / TILE_M;
+    ctx->tiles_n = (ctx->c->cols + TILE_N - 1) / TILE_N;
+    ctx->next_tile = 0;
+
+    perf_counters_start(&perf);
     clock_gettime(CLOCK_MONOTONIC, &start);
-    
-    for (int i = 0; i < THREADS; i++) {
-        data[i].start_row = i * (SIZE / THREADS);
-        data[i].end_row = (i + 1) * (SIZE / THREADS);
-        pthread_create(&threads[i], NULL, multiply, &data[i]);
+    for (int i = 0; i < threads; i++) {
+        // 行区间按比例切分，余数行不会丢失
+        data[i].ctx = ctx;
+        data[i].id = i;
+        data[i].start_row = m * i / threads;
+        data[i].end_row = m * (i + 1) / threads;
+        if (i > 0) {
+            started[i] = pthread_create(&tids[i], NULL, fn, &data[i]) == 0;
+        }
     }
-    
-    for (int i = 0; i < THREADS; i++) {
-        pthread_join(threads[i], NULL);
+    // 创建失败的线程的那份由调用线程自己完成，结果不受影响，只是少了并行度
+    for (int i = 0; i < threads; i++) {
+        if (!started[i]) {
+            fn(&data[i]);
+        }
     }
-    
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    time_parallel = (end.tv_sec - start.tv_sec) + 
-                    (end.tv_nsec - start.tv_nsec) / 1e9;
-    
-    printf("并行乘法: %.3f 秒\n", time_parallel);
-    
-    // 顺序乘法
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            matrix_c[i][j] = 0;
-            for (int k = 0; k < SIZE; k++) {
-                matrix_c[i][j] += matrix_a[i][k] * matrix_b[k][j];
-            }
+    for (int i = 1; i < threads; i++) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
         }
     }
-    
     clock_gettime(CLOCK_MONOTONIC, &end);
-    time_sequential = (end.tv_sec - start.tv_sec) + 
-                     (end.tv_nsec - start.tv_nsec) / 1e9;
-    
-    printf("顺序乘法: %.3f 秒\n", time_sequential);
-    printf("加速比: %.2fx\n", time_sequential / time_parallel);
-    
+    perf_counters_stop(&perf);
+
+    free(tids);
+    free(started);
+    free(data);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// 乘加次数，性能计数器按每次乘加折算
+static double madds(const gemm_ctx_t *ctx) {
+    return (double)ctx->c->rows * ctx->c->cols * ctx->a->cols;
+}
+
+static double gflops(const gemm_ctx_t *ctx, double seconds) {
+    return 2.0 * madds(ctx) / seconds / 1e9;
+}
+
+// 解析 "N" 或 "MxNxK"
+static int parse_dims(const char *s, long *m, long *n, long *k) {
+    int count = sscanf(s, "%ldx%ldx%ld", m, n, k);
+    if (count == 1) {
+        *n = *k = *m;
+    } else if (count != 3) {
+        return -1;
+    }
+    return *m > 0 && *n > 0 && *k > 0 ? 0 : -1;
+}
+
+static int parse_type(const char *s) {
+    for (int t = 0; t < ELEM_TYPES; t++) {
+        if (strcmp(s, elem_ops[t].name) == 0) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+// 从 1 到 max_threads 个线程的扩展性测试，比较静态切分和动态领取瓦片
+static void bench_scaling(gemm_ctx_t *ctx, int max_threads) {
+    double base = 0;
+
+    printf("%6s %12s %10s %12s %10s %10s %8s %14s\n", "线程", "静态(秒)", "GFLOP/s", "动态(秒)",
+           "GFLOP/s", "动态效率", "IPC", "LLC/千次乘加");
+    for (int t = 1; t <= max_threads; t++) {
+        ctx->sched = SCHED_STATIC;
+        double ts = run_gemm(ctx, multiply_tiles, t);
+        ctx->sched = SCHED_DYNAMIC;
+        double td = run_gemm(ctx, multiply_tiles, t);
+        if (t == 1) {
+            base = td;
+        }
+        double ipc = perf_counters_ipc(&perf);
+        double llc = perf_counters_per_op(&perf, PERF_LLC_MISSES, madds(ctx) / 1000);
+        printf("%6d %12.3f %10.2f %12.3f %10.2f %9.0f%%", t, ts, gflops(ctx, ts), td,
+               gflops(ctx, td), base / td / t * 100);
+        isnan(ipc) ? printf(" %8s", "-") : printf(" %8.2f", ipc);
+        isnan(llc) ? printf(" %14s\n", "-") : printf(" %14.3f\n", llc);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 0 ? (int)cpus : THREADS;
+    long m = SIZE, n = SIZE, k = SIZE;
+    int type = ELEM_I32, level, bench = 0;
+    const char *prog = argv[0], *kernel = NULL;
+    matrix_t a, b, c, c_naive;
+    gemm_ctx_t ctx;
+
+    // bench 子命令做扩展性测试，其余参数含义相同，线程数表示最大线程数
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench = 1;
+        argc--;
+        argv++;
+    }
+    if ((argc > 1 && parse_dims(argv[1], &m, &n, &k) != 0) ||
+        (argc > 2 && (type = parse_type(argv[2])) < 0) ||
+        (argc > 3 && (threads = atoi(argv[3])) < 1)) {
+        fprintf(stderr, "用法: %s [bench] [N|MxNxK] [i32|f32|f64] [线程数] [scalar|avx2|avx512]\n",
+                prog);
+        return 1;
+    }
+    if (argc > 4) {
+        kernel = argv[4];
+    }
+    if ((level = select_kernel(kernel)) < 0) {
+        return 1;
+    }
+
+    if (matrix_create(&a, type, m, k) != 0 || matrix_create(&b, type, k, n) != 0 ||
+        matrix_create(&c, type, m, n) != 0 || matrix_create(&c_naive, type, m, n) != 0) {
+        fprintf(stderr, "内存不足\n");
+        return 1;
+    }
+
+    ctx.a = &a;
+    ctx.b = &b;
+    ctx.c = &c;
+    ctx.ops = &elem_ops[type];
+    ctx.micro = ctx.ops->micro[level];
+    ctx.sched = SCHED_DYNAMIC;
+
+    // 初始化矩阵
+    srand(time(NULL));
+    ctx.ops->fill(&a);
+    ctx.ops->fill(&b);
+
+    // 计数器不可用时各项显示为 "-"，计时不受影响；LLC/分支未命中按每次乘加统计
+    perf_counters_open(&perf);
+    printf("C(%ldx%ld) = A(%ldx%ld) * B(%ldx%ld)，类型 %s，内核 %s\n", m, n, m, k, k, n,
+           ctx.ops->name, kernel_names[level]);
+
+    if (bench) {
+        bench_scaling(&ctx, threads);
+    } else {
+        double time_parallel, time_sequential, time_blocked, time_blocked_seq;
+
+        // 朴素乘法（按行静态切分）
+        ctx.c = &c_naive;
+        time_parallel = run_gemm(&ctx, multiply_naive, threads);
+        printf("并行乘法 (%d 线程): %.3f 秒 (%.2f GFLOP/s)\n", threads, time_parallel,
+               gflops(&ctx, time_parallel));
+        perf_counters_print(&perf, "并行乘法", madds(&ctx));
+        time_sequential = run_gemm(&ctx, multiply_naive, 1);
+        printf("顺序乘法: %.3f 秒 (%.2f GFLOP/s)\n", time_sequential,
+               gflops(&ctx, time_sequential));
+        perf_counters_print(&perf, "顺序乘法", madds(&ctx));
+
+        // 分块乘法（动态领取二维瓦片）
+        ctx.c = &c;
+        time_blocked = run_gemm(&ctx, multiply_tiles, threads);
+        printf("并行分块乘法 (%d 线程): %.3f 秒 (%.2f GFLOP/s)%s\n", threads, time_blocked,
+               gflops(&ctx, time_blocked), ctx.ops->equal(&c, &c_naive) ? "" : " 结果不一致!");
+        perf_counters_print(&perf, "并行分块乘法", madds(&ctx));
+        time_blocked_seq = run_gemm(&ctx, multiply_tiles, 1);
+        printf("顺序分块乘法: %.3f 秒 (%.2f GFLOP/s)%s\n", time_blocked_seq,
+               gflops(&ctx, time_blocked_seq), ctx.ops->equal(&c, &c_naive) ? "" : " 结果不一致!");
+        perf_counters_print(&perf, "顺序分块乘法", madds(&ctx));
+
+        printf("加速比: %.2fx（分块相对朴素: %.2fx）\n", time_sequential / time_parallel,
+               time_parallel / time_blocked);
+    }
+
+    matrix_destroy(&a);
+    matrix_destroy(&b);
+    matrix_destroy(&c);
+    matrix_destroy(&c_naive);
+    perf_counters_close(&perf);
+
     return 0;
-}
\ No newline at end of file
+}
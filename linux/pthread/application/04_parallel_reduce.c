@@ -0,0 +1,499 @@
+#include <stdio.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "perf_counters.h"
+
+#define THREADS 4
+#define DEMO_ELEMENTS 10000000L
+#define BENCH_ELEMENTS 1000000000L
+
+#define CACHE_ALIGNED __attribute__((aligned(64)))
+#define CHUNK_ALIGN 64              // 线程区间的起点按这么多元素对齐，相邻线程不会写同一缓存行
+#define ACC_BYTES 64                // 累加器最大字节数
+#define VEC_BYTES 32                // SIMD 累加器向量的字节数，每次迭代处理的元素数由累加器类型决定
+#define VALUE_MASK 1023             // data[i] = i & VALUE_MASK，平方和不会溢出任何元素类型
+
+// 与 barrier/02_parallel_compute.c 相同的三个阶段：data[i] = i，result[i] = data[i]^2，求和。
+// 这里把它们表达为数组上的并行 map/reduce：每个阶段是一个区间处理函数，
+// 框架负责切分区间、分配按缓存行填充的线程累加器并按顺序合并
+#if defined(__x86_64__)
+// SIMD 内核同时编译通用版本和 AVX2 版本，运行时按 CPU 自动选择
+#define SIMD_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define SIMD_KERNEL
+#endif
+// 标量基线禁止自动向量化，否则编译器会把它也变成 SIMD 代码
+#define SCALAR_KERNEL __attribute__((optimize("no-tree-vectorize")))
+
+typedef enum {
+    ELEM_I32,
+    ELEM_F32,
+    ELEM_F64,
+    ELEM_TYPES
+} elem_type_t;
+
+typedef enum {
+    KERNEL_SCALAR,
+    KERNEL_SIMD,
+    KERNEL_KINDS
+} kernel_kind_t;
+
+static const char *kernel_names[KERNEL_KINDS] = {"标量", "SIMD"};
+
+static perf_counters_t perf;    // run_pipeline 每次运行都会重新采集
+
+/* ---------------- 并行 map/reduce 框架 ---------------- */
+
+// 区间处理函数：处理 [begin, end)，归约类操作把结果折叠进 acc（map 操作的 acc 为 NULL）
+typedef void (*range_fn_t)(void *ctx, size_t begin, size_t end, void *acc);
+
+typedef struct {
+    range_fn_t fn;
+    void (*identity)(void *acc);                    // NULL 表示纯 map，没有累加器
+    void (*combine)(void *acc, const void *partial);
+} parallel_op_t;
+
+// 每个线程的累加器独占一条缓存行，归约过程中线程之间没有任何共享写
+typedef union {
+    unsigned char bytes[ACC_BYTES];
+    long double align;
+} CACHE_ALIGNED acc_slot_t;
+
+typedef struct {
+    const parallel_op_t *op;
+    void *ctx;
+    size_t begin;
+    size_t end;
+    acc_slot_t *acc;
+} range_task_t;
+
+static void *range_worker(void *arg) {
+    range_task_t *task = (range_task_t *)arg;
+
+    task->op->fn(task->ctx, task->begin, task->end,
+                 task->op->identity ? task->acc->bytes : NULL);
+    return NULL;
+}
+
+// 用 threads 个线程在 [0, n) 上执行 op；归约操作的结果按线程顺序合并到 result
+static void parallel_run(const parallel_op_t *op, void *ctx, size_t n, int threads,
+                         void *result) {
+    pthread_t *tids = malloc(sizeof(pthread_t) * threads);
+    char *started = calloc(threads, 1);
+    range_task_t *tasks = malloc(sizeof(range_task_t) * threads);
+    acc_slot_t *accs;
+
+    if (tids == NULL || started == NULL || tasks == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    if (posix_memalign((void **)&accs, 64, sizeof(acc_slot_t) * threads) != 0) {
+        perror("posix_memalign");
+        exit(1);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        // 按比例切分后把边界向下对齐到 CHUNK_ALIGN，最后一段延伸到 n
+        tasks[i].op = op;
+        tasks[i].ctx = ctx;
+        tasks[i].begin = n * i / threads / CHUNK_ALIGN * CHUNK_ALIGN;
+        tasks[i].end = i + 1 == threads ? n : n * (i + 1) / threads / CHUNK_ALIGN * CHUNK_ALIGN;
+        tasks[i].acc = &accs[i];
+        if (op->identity) {
+            op->identity(accs[i].bytes);
+        }
+        if (i > 0) {
+            started[i] = pthread_create(&tids[i], NULL, range_worker, &tasks[i]) == 0;
+        }
+    }
+    // 创建失败的区间由调用线程自己完成，结果不受影响，只是少了并行度
+    for (int i = 0; i < threads; i++) {
+        if (!started[i]) {
+            range_worker(&tasks[i]);
+        }
+    }
+    for (int i = 1; i < threads; i++) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
+        }
+    }
+
+    if (op->identity) {
+        op->identity(result);
+        for (int i = 0; i < threads; i++) {
+            op->combine(result, accs[i].bytes);
+        }
+    }
+
+    free(tids);
+    free(started);
+    free(tasks);
+    free(accs);
+}
+
+/* ---------------- 按元素类型生成的内核 ---------------- */
+
+typedef struct {
+    void *data;
+    void *result;
+} arrays_t;
+
+typedef struct {
+    const char *name;
+    size_t size;
+    range_fn_t init[KERNEL_KINDS];      // data[i] = i & VALUE_MASK
+    range_fn_t square[KERNEL_KINDS];    // result[i] = data[i] * data[i]
+    range_fn_t sum[KERNEL_KINDS];       // acc += result[i]
+    range_fn_t fused[KERNEL_KINDS];     // 一次遍历完成以上三步
+    void (*identity)(void *acc);
+    void (*combine)(void *acc, const void *partial);
+    double (*value)(const void *acc);   // 累加器转成 double 以便打印和校验
+} elem_ops_t;
+
+// T 为元素类型，ACC 为累加器类型（整数用 64 位、浮点用 double，避免求和溢出或丢精度）。
+// SIMD 版本用 GCC 向量扩展写成与类型无关的形式，由编译器映射到目标平台的向量指令；
+// 每次迭代的元素数按累加器向量正好占一个寄存器来取，避免加宽后的累加器溢出到栈上。
+// 读写经 memcpy 进行，不要求数组按向量宽度对齐
+#define DEFINE_REDUCE_TYPE(S, T, ACC)                                                   \
+enum { S##_LANES = VEC_BYTES / sizeof(ACC) };                                           \
+typedef T S##_vec_t __attribute__((vector_size(S##_LANES * sizeof(T))));                \
+typedef ACC S##_accvec_t __attribute__((vector_size(VEC_BYTES)));                       \
+typedef uint32_t S##_idxvec_t __attribute__((vector_size(S##_LANES * 4)));             \
+                                                                                        \
+static void identity_##S(void *acc) {                                                   \
+    *(ACC *)acc = 0;                                                                    \
+}                                                                                       \
+                                                                                        \
+static void combine_##S(void *acc, const void *partial) {                               \
+    *(ACC *)acc += *(const ACC *)partial;                                               \
+}                                                                                       \
+                                                                                        \
+static double value_##S(const void *acc) {                                              \
+    return (double)*(const ACC *)acc;                                                   \
+}                                                                                       \
+                                                                                        \
+SCALAR_KERNEL static void init_scalar_##S(void *ctx, size_t b, size_t e, void *acc) {   \
+    T *data = ((arrays_t *)ctx)->data;                                                  \
+    (void)acc;                                                                          \
+    for (size_t i = b; i < e; i++) {                                                    \
+        data[i] = (T)(i & VALUE_MASK);                                                  \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+SCALAR_KERNEL static void square_scalar_##S(void *ctx, size_t b, size_t e, void *acc) { \
+    const T *data = ((arrays_t *)ctx)->data;                                            \
+    T *result = ((arrays_t *)ctx)->result;                                              \
+    (void)acc;                                                                          \
+    for (size_t i = b; i < e; i++) {                                                    \
+        result[i] = data[i] * data[i];                                                  \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+SCALAR_KERNEL static void sum_scalar_##S(void *ctx, size_t b, size_t e, void *acc) {    \
+    const T *result = ((arrays_t *)ctx)->result;                                        \
+    ACC sum = 0;                                                                        \
+    for (size_t i = b; i < e; i++) {                                                    \
+        sum += result[i];                                                               \
+    }                                                                                   \
+    *(ACC *)acc += sum;                                                                 \
+}                                                                                       \
+                                                                                        \
+SCALAR_KERNEL static void fused_scalar_##S(void *ctx, size_t b, size_t e, void *acc) {  \
+    T *data = ((arrays_t *)ctx)->data;                                                  \
+    T *result = ((arrays_t *)ctx)->result;                                              \
+    ACC sum = 0;                                                                        \
+    for (size_t i = b; i < e; i++) {                                                    \
+        T v = (T)(i & VALUE_MASK);                                                      \
+        data[i] = v;                                                                    \
+        result[i] = v * v;                                                              \
+        sum += result[i];                                                               \
+    }                                                                                   \
+    *(ACC *)acc += sum;                                                                 \
+}                                                                                       \
+                                                                                        \
+/* 下标向量 {i, i+1, ...}；每次迭代整体加 LANES，按掩码取低位即为初值，回绕到 32 位不影响低位 */ \
+static inline void index_start_##S(size_t i, S##_idxvec_t *idx) {                      \
+    for (int l = 0; l < S##_LANES; l++) {                                               \
+        (*idx)[l] = (uint32_t)(i + l);                                                  \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static inline ACC hsum_##S(const S##_accvec_t *v) {                                     \
+    ACC sum = 0;                                                                        \
+    for (int l = 0; l < S##_LANES; l++) {                                               \
+        sum += (*v)[l];                                                                 \
+    }                                                                                   \
+    return sum;                                                                         \
+}                                                                                       \
+                                                                                        \
+SIMD_KERNEL static void init_simd_##S(void *ctx, size_t b, size_t e, void *acc) {       \
+    T *data = ((arrays_t *)ctx)->data;                                                  \
+    S##_idxvec_t idx;                                                                   \
+    size_t i = b;                                                                       \
+    (void)acc;                                                                          \
+    index_start_##S(i, &idx);                                                           \
+    for (; i + S##_LANES <= e; i += S##_LANES, idx += S##_LANES) {                      \
+        S##_vec_t v = __builtin_convertvector(idx & VALUE_MASK, S##_vec_t);             \
+        memcpy(&data[i], &v, sizeof(v));                                                \
+    }                                                                                   \
+    for (; i < e; i++) {                                                                \
+        data[i] = (T)(i & VALUE_MASK);                                                  \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+SIMD_KERNEL static void square_simd_##S(void *ctx, size_t b, size_t e, void *acc) {     \
+    const T *data = ((arrays_t *)ctx)->data;                                            \
+    T *result = ((arrays_t *)ctx)->result;                                              \
+    size_t i = b;                                                                       \
+    (void)acc;                                                                          \
+    for (; i + S##_LANES <= e; i += S##_LANES) {                                        \
+        S##_vec_t v;                                                                    \
+        memcpy(&v, &data[i], sizeof(v));                                                \
+        v = v * v;                                                                      \
+        memcpy(&result[i], &v, sizeof(v));                                              \
+    }                                                                                   \
+    for (; i < e; i++) {                                                                \
+        result[i] = data[i] * data[i];                                                  \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+SIMD_KERNEL static void sum_simd_##S(void *ctx, size_t b, size_t e, void *acc) {        \
+    const T *result = ((arrays_t *)ctx)->result;                                        \
+    S##_accvec_t vsum = {0};                                                            \
+    ACC sum = 0;                                                                        \
+    size_t i = b;                                                                       \
+    for (; i + S##_LANES <= e; i += S##_LANES) {                                        \
+        S##_vec_t v;                                                                    \
+        memcpy(&v, &result[i], sizeof(v));                                              \
+        vsum += __builtin_convertvector(v, S##_accvec_t);                               \
+    }                                                                                   \
+    for (; i < e; i++) {                                                                \
+        sum += result[i];                                                               \
+    }                                                                                   \
+    *(ACC *)acc += sum + hsum_##S(&vsum);                                                \
+}                                                                                       \
+                                                                                        \
+SIMD_KERNEL static void fused_simd_##S(void *ctx, size_t b, size_t e, void *acc) {      \
+    T *data = ((arrays_t *)ctx)->data;                                                  \
+    T *result = ((arrays_t *)ctx)->result;                                              \
+    S##_accvec_t vsum = {0};                                                            \
+    S##_idxvec_t idx;                                                                   \
+    ACC sum = 0;                                                                        \
+    size_t i = b;                                                                       \
+    index_start_##S(i, &idx);                                                           \
+    for (; i + S##_LANES <= e; i += S##_LANES, idx += S##_LANES) {                      \
+        S##_vec_t v = __builtin_convertvector(idx & VALUE_MASK, S##_vec_t);             \
+        S##_vec_t sq = v * v;                                                           \
+        memcpy(&data[i], &v, sizeof(v));                                                \
+        memcpy(&result[i], &sq, sizeof(sq));                                            \
+        vsum += __builtin_convertvector(sq, S##_accvec_t);                              \
+    }                                                                                   \
+    for (; i < e; i++) {                                                                \
+        T v = (T)(i & VALUE_MASK);                                                      \
+        data[i] = v;                                                                    \
+        result[i] = v * v;                                                              \
+        sum += result[i];                                                               \
+    }                                                                                   \
+    *(ACC *)acc += sum + hsum_##S(&vsum);                                                \
+}
+
+DEFINE_REDUCE_TYPE(i32, int32_t, int64_t)
+DEFINE_REDUCE_TYPE(f32, float, double)
+DEFINE_REDUCE_TYPE(f64, double, double)
+
+#define ELEM_OPS(S, T)                                                                  \
+    {#S, sizeof(T), {init_scalar_##S, init_simd_##S}, {square_scalar_##S, square_simd_##S}, \
+     {sum_scalar_##S, sum_simd_##S}, {fused_scalar_##S, fused_simd_##S}, identity_##S,  \
+     combine_##S, value_##S}
+
+static const elem_ops_t elem_ops[ELEM_TYPES] = {
+    [ELEM_I32] = ELEM_OPS(i32, int32_t),
+    [ELEM_F32] = ELEM_OPS(f32, float),
+    [ELEM_F64] = ELEM_OPS(f64, double),
+};
+
+/* ---------------- 三阶段流水线 ---------------- */
+
+// 分阶段：三个操作各遍历一次数组，线程在阶段之间汇合（相当于屏障）；融合：只遍历一次
+static double run_pipeline(const elem_ops_t *ops, arrays_t *arrays, size_t n, int threads,
+                           kernel_kind_t kind, int fused, void *total) {
+    struct timespec start, end;
+
+    perf_counters_start(&perf);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (fused) {
+        parallel_op_t fused_op = {ops->fused[kind], ops->identity, ops->combine};
+        parallel_run(&fused_op, arrays, n, threads, total);
+    } else {
+        parallel_op_t init_op = {ops->init[kind], NULL, NULL};
+        parallel_op_t square_op = {ops->square[kind], NULL, NULL};
+        parallel_op_t sum_op = {ops->sum[kind], ops->identity, ops->combine};
+        parallel_run(&init_op, arrays, n, threads, NULL);
+        parallel_run(&square_op, arrays, n, threads, NULL);
+        parallel_run(&sum_op, arrays, n, threads, total);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_counters_stop(&perf);
+
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// 所有 (i & VALUE_MASK)^2 之和的精确值；数值都是不超过 2^53 的整数，double 可以精确表示
+static double expected_total(size_t n) {
+    double period = VALUE_MASK + 1, full = 0, partial = 0;
+
+    for (size_t j = 0; j <= VALUE_MASK; j++) {
+        full += (double)j * j;
+        if (j < n % (VALUE_MASK + 1)) {
+            partial += (double)j * j;
+        }
+    }
+    return (double)(n / (size_t)period) * full + partial;
+}
+
+static int fits_memory(double bytes) {
+    long pages = sysconf(_SC_AVPHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || page_size <= 0) {
+        return 1;
+    }
+    return bytes < (double)pages * page_size * 0.9;
+}
+
+// 分配 data 和 result 两个数组；可用内存不足时把 n 减半直到放得下
+static int arrays_create(arrays_t *arrays, size_t size, size_t *n) {
+    while (*n > 0 && !fits_memory(2.0 * size * *n)) {
+        *n /= 2;
+    }
+    if (*n == 0 || posix_memalign(&arrays->data, 64, size * *n) != 0) {
+        return -1;
+    }
+    if (posix_memalign(&arrays->result, 64, size * *n) != 0) {
+        free(arrays->data);
+        return -1;
+    }
+    return 0;
+}
+
+static void arrays_destroy(arrays_t *arrays) {
+    free(arrays->data);
+    free(arrays->result);
+}
+
+static int parse_type(const char *s) {
+    for (int t = 0; t < ELEM_TYPES; t++) {
+        if (strcmp(s, elem_ops[t].name) == 0) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+// 对每种元素类型比较 分阶段/融合 × 标量/SIMD 四种组合，每组取 3 次中最快的一次
+static void bench(size_t requested, int type, int threads) {
+    printf("分阶段的每一步各自创建并回收一次线程，其计时包含三次线程启动开销，融合只有一次\n");
+    printf("%-5s %12s %14s %14s %14s %14s %10s\n", "类型", "元素数", "分阶段标量(秒)",
+           "分阶段SIMD", "融合标量", "融合SIMD", "总加速比");
+    for (int t = 0; t < ELEM_TYPES; t++) {
+        const elem_ops_t *ops = &elem_ops[t];
+        size_t n = requested;
+        arrays_t arrays;
+        double best[2][KERNEL_KINDS];
+        int ok = 1;
+
+        if (type >= 0 && t != type) {
+            continue;
+        }
+        if (arrays_create(&arrays, ops->size, &n) != 0) {
+            printf("%-5s %12s\n", ops->name, "内存不足");
+            continue;
+        }
+        double expected = expected_total(n);
+        acc_slot_t total;  // 与线程累加器一样按 long double 对齐，ops->value 按元素类型读取
+
+        // 先完整写一遍，让页面在计时之前就被分配好
+        run_pipeline(ops, &arrays, n, threads, KERNEL_SIMD, 1, total.bytes);
+        for (int fused = 0; fused < 2; fused++) {
+            for (int kind = 0; kind < KERNEL_KINDS; kind++) {
+                best[fused][kind] = 0;
+                for (int rep = 0; rep < 3; rep++) {
+                    double s = run_pipeline(ops, &arrays, n, threads, kind, fused, total.bytes);
+                    if (rep == 0 || s < best[fused][kind]) {
+                        best[fused][kind] = s;
+                    }
+                    ok &= ops->value(total.bytes) == expected;
+                }
+            }
+        }
+        printf("%-5s %12zu %14.3f %14.3f %14.3f %14.3f %9.2fx%s%s\n", ops->name, n,
+               best[0][KERNEL_SCALAR], best[0][KERNEL_SIMD], best[1][KERNEL_SCALAR],
+               best[1][KERNEL_SIMD], best[0][KERNEL_SCALAR] / best[1][KERNEL_SIMD],
+               n < requested ? " (内存不足，已缩小)" : "", ok ? "" : " 结果不一致!");
+        fflush(stdout);
+        arrays_destroy(&arrays);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 0 ? (int)cpus : THREADS;
+    int type = ELEM_I32, bench_mode = 0;
+    long n;
+    const char *prog = argv[0];
+
+    // bench 子命令默认在 1e9 个元素上对所有类型测试，指定类型时只测该类型
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_mode = 1;
+        type = -1;
+        argc--;
+        argv++;
+    }
+    n = bench_mode ? BENCH_ELEMENTS : DEMO_ELEMENTS;
+    if ((argc > 1 && (n = atol(argv[1])) < 1) ||
+        (argc > 2 && (type = parse_type(argv[2])) < 0) ||
+        (argc > 3 && (threads = atoi(argv[3])) < 1)) {
+        fprintf(stderr, "用法: %s [bench] [元素个数] [i32|f32|f64] [线程数]\n", prog);
+        return 1;
+    }
+
+    // 计数器不可用时各项显示为 "-"，计时不受影响；LLC/分支未命中按每个元素统计
+    perf_counters_open(&perf);
+    if (bench_mode) {
+        bench((size_t)n, type, threads);
+    } else {
+        const elem_ops_t *ops = &elem_ops[type];
+        size_t size = (size_t)n;
+        arrays_t arrays;
+
+        if (arrays_create(&arrays, ops->size, &size) != 0 || size < (size_t)n) {
+            fprintf(stderr, "内存不足\n");
+            return 1;
+        }
+        printf("%zu 个 %s 元素，%d 线程，期望总和 = %.0f\n", size, ops->name, threads,
+               expected_total(size));
+        acc_slot_t warm;
+        run_pipeline(ops, &arrays, size, threads, KERNEL_SIMD, 1, warm.bytes);
+        for (int fused = 0; fused < 2; fused++) {
+            for (int kind = 0; kind < KERNEL_KINDS; kind++) {
+                acc_slot_t total;
+                char label[64];
+                double s = run_pipeline(ops, &arrays, size, threads, kind, fused, total.bytes);
+
+                snprintf(label, sizeof(label), "%s%s", fused ? "融合" : "分阶段",
+                         kernel_names[kind]);
+                printf("%s: %.3f 秒，总和 = %.0f%s\n", label, s, ops->value(total.bytes),
+                       ops->value(total.bytes) == expected_total(size) ? "" : " 结果不一致!");
+                perf_counters_print(&perf, label, (double)size);
+            }
+        }
+        arrays_destroy(&arrays);
+    }
+    perf_counters_close(&perf);
+
+    return 0;
+}
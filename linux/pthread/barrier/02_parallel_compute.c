@@ -1,61 +1,285 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #define SIZE 1000
 #define THREADS 4
 
+#define CACHE_ALIGNED __attribute__((aligned(64)))
+#define MAX_THREADS 256
+#define MAX_ROUNDS 8                // ceil(log2(MAX_THREADS))
+#define SPIN_LIMIT 64               // 自旋这么多次仍未等到就让出 CPU
+#define BENCH_CROSSINGS 20000
+
 int data[SIZE];
 int result[SIZE];
 pthread_barrier_t barrier;
 
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+// 用户态屏障的等待：先自旋，线程数超过 CPU 数时还没到齐的线程可能没在运行，自旋过久就让出 CPU
+static inline void spin_wait(int *spins) {
+    if (++*spins < SPIN_LIMIT) {
+        cpu_relax();
+    } else {
+        sched_yield();
+    }
+}
+
+/* ---------------- pthread_barrier_t ---------------- */
+
+static void posix_init(int n) {
+    pthread_barrier_init(&barrier, NULL, n);
+}
+
+static void posix_wait(int id) {
+    (void)id;
+    pthread_barrier_wait(&barrier);
+}
+
+static void posix_destroy(void) {
+    pthread_barrier_destroy(&barrier);
+}
+
+/* ---------------- 集中式翻转标志屏障 ---------------- */
+
+// 最后一个到达的线程重置计数并翻转全局标志，其余线程只读等待标志变成自己这一轮的值
+static struct {
+    atomic_int count CACHE_ALIGNED;
+    atomic_int sense CACHE_ALIGNED;
+    int n;
+} central;
+
+static struct {
+    int sense;
+} CACHE_ALIGNED central_local[MAX_THREADS];
+
+static void central_init(int n) {
+    atomic_store(&central.count, n);
+    atomic_store(&central.sense, 0);
+    central.n = n;
+    for (int i = 0; i < n; i++) {
+        central_local[i].sense = 0;
+    }
+}
+
+static void central_wait(int id) {
+    int sense = !central_local[id].sense;
+    int spins = 0;
+
+    central_local[id].sense = sense;
+    if (atomic_fetch_sub_explicit(&central.count, 1, memory_order_acq_rel) == 1) {
+        atomic_store_explicit(&central.count, central.n, memory_order_relaxed);
+        atomic_store_explicit(&central.sense, sense, memory_order_release);
+    } else {
+        while (atomic_load_explicit(&central.sense, memory_order_acquire) != sense) {
+            spin_wait(&spins);
+        }
+    }
+}
+
+static void central_destroy(void) {
+}
+
+/* ---------------- 传播（dissemination）屏障 ---------------- */
+
+// 共 ceil(log2 n) 轮，第 r 轮线程 i 通知线程 (i + 2^r) mod n 并等待 (i - 2^r) mod n 的通知；
+// 没有共享计数器，每个标志只有一个写者和一个读者。标志按奇偶两套交替使用，
+// 每用完两套翻转一次 sense，这样标志不需要复位
+typedef struct {
+    atomic_int flags[2][MAX_ROUNDS];
+    int parity;
+    int sense;
+} CACHE_ALIGNED dissem_node_t;
+
+static dissem_node_t dissem_nodes[MAX_THREADS];
+static int dissem_n, dissem_rounds;
+
+static void dissem_init(int n) {
+    dissem_n = n;
+    dissem_rounds = 0;
+    while ((1 << dissem_rounds) < n) {
+        dissem_rounds++;
+    }
+    memset(dissem_nodes, 0, sizeof(dissem_node_t) * n);
+    for (int i = 0; i < n; i++) {
+        dissem_nodes[i].sense = 1;
+    }
+}
+
+static void dissem_wait(int id) {
+    dissem_node_t *me = &dissem_nodes[id];
+
+    for (int r = 0; r < dissem_rounds; r++) {
+        dissem_node_t *partner = &dissem_nodes[(id + (1 << r)) % dissem_n];
+        int spins = 0;
+
+        atomic_store_explicit(&partner->flags[me->parity][r], me->sense, memory_order_release);
+        while (atomic_load_explicit(&me->flags[me->parity][r], memory_order_acquire) != me->sense) {
+            spin_wait(&spins);
+        }
+    }
+    if (me->parity == 1) {
+        me->sense = !me->sense;
+    }
+    me->parity = 1 - me->parity;
+}
+
+static void dissem_destroy(void) {
+}
+
+typedef struct {
+    const char *name;
+    void (*init)(int n);
+    void (*wait)(int id);
+    void (*destroy)(void);
+} barrier_ops_t;
+
+static const barrier_ops_t barriers[] = {
+    {"pthread_barrier", posix_init, posix_wait, posix_destroy},
+    {"集中式翻转", central_init, central_wait, central_destroy},
+    {"传播屏障", dissem_init, dissem_wait, dissem_destroy},
+};
+
+#define BARRIER_KINDS (int)(sizeof(barriers) / sizeof(barriers[0]))
+
+static const barrier_ops_t *ops;
+static atomic_long total;           // 阶段3的全局总和，各线程用原子加归约，无需加锁
+
 void *parallel_compute(void *arg) {
     int id = (int)(long)arg;
     int start = id * (SIZE / THREADS);
     int end = (id + 1) * (SIZE / THREADS);
-    
+
     // 阶段1: 初始化数据
     for (int i = start; i < end; i++) {
         data[i] = i;
     }
-    
+
     printf("线程 %d: 阶段1完成\n", id);
-    pthread_barrier_wait(&barrier);
-    
+    ops->wait(id);
+
     // 阶段2: 计算平方
     for (int i = start; i < end; i++) {
         result[i] = data[i] * data[i];
     }
-    
+
     printf("线程 %d: 阶段2完成\n", id);
-    pthread_barrier_wait(&barrier);
-    
+    ops->wait(id);
+
     // 阶段3: 计算总和
-    int sum = 0;
+    long sum = 0;
     for (int i = start; i < end; i++) {
         sum += result[i];
     }
-    
-    printf("线程 %d: 阶段3完成，局部和 = %d\n", id, sum);
-    
+    atomic_fetch_add_explicit(&total, sum, memory_order_relaxed);
+
+    printf("线程 %d: 阶段3完成，局部和 = %ld\n", id, sum);
+
     return NULL;
 }
 
-int main() {
+/* ---------------- 基准测试 ---------------- */
+
+static int bench_crossings;
+
+static void *bench_worker(void *arg) {
+    int id = (int)(long)arg;
+
+    for (int i = 0; i < bench_crossings; i++) {
+        ops->wait(id);
+    }
+    return NULL;
+}
+
+// 线程数从 2 翻倍到 max_threads（最后一组取 max_threads 本身），每组所有线程连续跨越屏障
+static void bench(int max_threads, int crossings) {
+    pthread_t tids[MAX_THREADS];
+
+    bench_crossings = crossings;
+    printf("每组跨越屏障 %d 次，单位: 千次跨越/秒\n", crossings);
+    printf("%-8s", "线程数");
+    for (int k = 0; k < BARRIER_KINDS; k++) {
+        printf(" %16s", barriers[k].name);
+    }
+    printf("\n");
+
+    for (int n = 2;; n = n * 2 < max_threads ? n * 2 : max_threads) {
+        printf("%-8d", n);
+        for (int k = 0; k < BARRIER_KINDS; k++) {
+            struct timespec start, end;
+
+            ops = &barriers[k];
+            ops->init(n);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (int i = 0; i < n; i++) {
+                pthread_create(&tids[i], NULL, bench_worker, (void *)(long)i);
+            }
+            for (int i = 0; i < n; i++) {
+                pthread_join(tids[i], NULL);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            ops->destroy();
+
+            double t = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+            printf(" %16.1f", crossings / t / 1e3);
+        }
+        printf("\n");
+        fflush(stdout);
+        if (n >= max_threads) {
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
     pthread_t threads[THREADS];
-    
-    pthread_barrier_init(&barrier, NULL, THREADS);
-    
-    for (int i = 0; i < THREADS; i++) {
-        pthread_create(&threads[i], NULL, parallel_compute, (void *)(long)i);
+
+    // bench [最大线程数] [跨越次数]，最大线程数默认为在线 CPU 数（至少 2）
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        int max_threads = argc > 2 ? atoi(argv[2]) : (cpus > 2 ? (int)cpus : 2);
+        int crossings = argc > 3 ? atoi(argv[3]) : BENCH_CROSSINGS;
+        if (max_threads < 2 || max_threads > MAX_THREADS || crossings < 1) {
+            fprintf(stderr, "用法: %s bench [最大线程数(2-%d)] [跨越次数]\n", argv[0],
+                    MAX_THREADS);
+            return 1;
+        }
+        bench(max_threads, crossings);
+        return 0;
     }
-    
-    for (int i = 0; i < THREADS; i++) {
-        pthread_join(threads[i], NULL);
+
+    for (int k = 0; k < BARRIER_KINDS; k++) {
+        ops = &barriers[k];
+        printf("=== %s ===\n", ops->name);
+        atomic_store(&total, 0);
+        ops->init(THREADS);
+
+        for (int i = 0; i < THREADS; i++) {
+            pthread_create(&threads[i], NULL, parallel_compute, (void *)(long)i);
+        }
+
+        for (int i = 0; i < THREADS; i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        ops->destroy();
+        printf("总和 = %ld\n\n", atomic_load(&total));
     }
-    
-    pthread_barrier_destroy(&barrier);
-    
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+#include "perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} perf_events[PERF_EVENTS] = {
+    [PERF_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [PERF_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    // 通用的 cache-misses 事件在 x86 上对应最后一级缓存未命中
+    [PERF_LLC_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    [PERF_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    [PERF_CONTEXT_SWITCHES] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+int perf_counters_open(perf_counters_t *pc) {
+    int available = 0;
+
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_events[i].type;
+        attr.config = perf_events[i].config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        // 硬件事件只统计用户态，普通用户在 perf_event_paranoid <= 2 时即可使用；
+        // 上下文切换发生在内核里，排除内核就永远是 0，先尝试包含内核，被拒绝再退回只统计用户态
+        attr.exclude_kernel = attr.type == PERF_TYPE_HARDWARE;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        pc->fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (pc->fd[i] < 0 && !attr.exclude_kernel) {
+            attr.exclude_kernel = 1;
+            pc->fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+        pc->value[i] = 0;
+        if (pc->fd[i] >= 0) {
+            available++;
+        }
+    }
+    return available;
+}
+
+void perf_counters_close(perf_counters_t *pc) {
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        if (pc->fd[i] >= 0) {
+            close(pc->fd[i]);
+            pc->fd[i] = -1;
+        }
+    }
+}
+
+// 读出 value, time_enabled, time_running 三元组
+static int read_raw(int fd, uint64_t raw[3]) {
+    return read(fd, raw, sizeof(uint64_t) * 3) == (ssize_t)(sizeof(uint64_t) * 3) ? 0 : -1;
+}
+
+// 已退出线程的计数会并入父计数器，PERF_EVENT_IOC_RESET 清不掉这部分，
+// 所以 start 时记下原始值，stop 时取差值
+void perf_counters_start(perf_counters_t *pc) {
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        if (pc->fd[i] >= 0) {
+            if (read_raw(pc->fd[i], pc->base[i]) != 0) {
+                memset(pc->base[i], 0, sizeof(pc->base[i]));
+            }
+            ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void perf_counters_stop(perf_counters_t *pc) {
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        uint64_t raw[3];
+
+        if (pc->fd[i] < 0) {
+            continue;
+        }
+        ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read_raw(pc->fd[i], raw) != 0) {
+            pc->value[i] = 0;
+            continue;
+        }
+        uint64_t count = raw[0] - pc->base[i][0];
+        uint64_t enabled = raw[1] - pc->base[i][1];
+        uint64_t running = raw[2] - pc->base[i][2];
+        // 计数器多于硬件寄存器时内核会分时复用，按实际运行时间比例换算
+        pc->value[i] = running > 0 && running < enabled
+                           ? (uint64_t)((double)count * enabled / running)
+                           : count;
+    }
+}
+
+int perf_counters_available(const perf_counters_t *pc, perf_event_id_t id) {
+    return pc->fd[id] >= 0;
+}
+
+double perf_counters_ipc(const perf_counters_t *pc) {
+    if (!perf_counters_available(pc, PERF_CYCLES) ||
+        !perf_counters_available(pc, PERF_INSTRUCTIONS) || pc->value[PERF_CYCLES] == 0) {
+        return NAN;
+    }
+    return (double)pc->value[PERF_INSTRUCTIONS] / pc->value[PERF_CYCLES];
+}
+
+double perf_counters_per_op(const perf_counters_t *pc, perf_event_id_t id, double ops) {
+    if (!perf_counters_available(pc, id) || ops <= 0) {
+        return NAN;
+    }
+    return pc->value[id] / ops;
+}
+
+// 不可用的值显示为 "-"
+static const char *format_value(char *buf, size_t len, const char *fmt, double v) {
+    if (isnan(v)) {
+        return "-";
+    }
+    snprintf(buf, len, fmt, v);
+    return buf;
+}
+
+void perf_counters_print(const perf_counters_t *pc, const char *label, double ops) {
+    char ipc[32], llc[32], branch[32], cs[32];
+
+    printf("  [%s] IPC %s，LLC 未命中/操作 %s，分支未命中/操作 %s，上下文切换 %s\n", label,
+           format_value(ipc, sizeof(ipc), "%.2f", perf_counters_ipc(pc)),
+           format_value(llc, sizeof(llc), "%.4f",
+                        perf_counters_per_op(pc, PERF_LLC_MISSES, ops)),
+           format_value(branch, sizeof(branch), "%.4f",
+                        perf_counters_per_op(pc, PERF_BRANCH_MISSES, ops)),
+           format_value(cs, sizeof(cs), "%.0f",
+                        perf_counters_per_op(pc, PERF_CONTEXT_SWITCHES, 1)));
+}
@@ -0,0 +1,43 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+
+// 基于 perf_event_open 的硬件性能计数器，供各个基准测试测量代码区间
+// 计数器在调用线程上以 inherit 方式打开，之后创建的线程也会被统计（线程退出后汇总到父计数器），
+// 因此测量区间内创建的线程必须在 perf_counters_stop 之前 join
+// 某个计数器打不开（虚拟机、容器或 perf_event_paranoid 限制）时只是标记为不可用，其余照常工作
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_CONTEXT_SWITCHES,
+    PERF_EVENTS
+} perf_event_id_t;
+
+typedef struct {
+    int fd[PERF_EVENTS];            // -1 表示该计数器不可用
+    uint64_t value[PERF_EVENTS];    // 最近一次 stop 读到的值，已按多路复用比例换算
+    uint64_t base[PERF_EVENTS][3];  // start 时读到的原始值：计数、启用时间、运行时间
+} perf_counters_t;
+
+// 打开所有计数器，返回可用的个数
+int perf_counters_open(perf_counters_t *pc);
+void perf_counters_close(perf_counters_t *pc);
+
+// 开始计数 / 停止计数并把这段区间的增量写到 value
+void perf_counters_start(perf_counters_t *pc);
+void perf_counters_stop(perf_counters_t *pc);
+
+int perf_counters_available(const perf_counters_t *pc, perf_event_id_t id);
+
+// 每周期指令数（IPC）和每次操作的事件数；计数器不可用时返回 NAN
+double perf_counters_ipc(const perf_counters_t *pc);
+double perf_counters_per_op(const perf_counters_t *pc, perf_event_id_t id, double ops);
+
+// 打印一行摘要：IPC、每次操作的 LLC 未命中和分支未命中、上下文切换次数，不可用的项显示为 "-"
+void perf_counters_print(const perf_counters_t *pc, const char *label, double ops);
+
+#endif
@@ -1,9 +1,25 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
 #define BUFFER_SIZE 5
 
+#define CACHELINE 64
+#define CACHE_ALIGNED __attribute__((aligned(CACHELINE)))
+#define RING_CAPACITY 1024          // 基准测试中两种队列的容量，必须是 2 的幂
+#define SPIN_BEFORE_WAIT 128        // 阻塞前先自旋重试的次数
+#define BENCH_ITEMS 10000000
+#define BENCH_BATCH 64
+#define LATENCY_ROUNDS 100000
+
 int buffer[BUFFER_SIZE];
 int count = 0;
 int in = 0, out = 0;
@@ -16,23 +32,23 @@ void *producer(void *arg) {
     (void)arg;
     for (int i = 0; i < 10; i++) {
         pthread_mutex_lock(&mutex);
-        
+
         // 等待缓冲区不满
         while (count == BUFFER_SIZE) {
             printf("缓冲区满，生产者等待\n");
             pthread_cond_wait(&not_full, &mutex);
         }
-        
+
         // 生产数据
         buffer[in] = i;
         printf("生产者生产: %d\n", i);
         in = (in + 1) % BUFFER_SIZE;
         count++;
-        
+
         // 通知消费者
         pthread_cond_signal(&not_empty);
         pthread_mutex_unlock(&mutex);
-        
+
         sleep(1);
     }
     return NULL;
@@ -42,36 +58,422 @@ void *consumer(void *arg) {
     (void)arg;
     for (int i = 0; i < 10; i++) {
         pthread_mutex_lock(&mutex);
-        
+
         // 等待缓冲区不空
         while (count == 0) {
             printf("缓冲区空，消费者等待\n");
             pthread_cond_wait(&not_empty, &mutex);
         }
-        
+
         // 消费数据
         int item = buffer[out];
         printf("消费者消费: %d\n", item);
         out = (out + 1) % BUFFER_SIZE;
         count--;
-        
+
         // 通知生产者
         pthread_cond_signal(&not_full);
         pthread_mutex_unlock(&mutex);
-        
+
         sleep(1);
     }
     return NULL;
 }
 
-int main() {
+/* ---------------- 无锁单生产者/单消费者环形队列 ---------------- */
+
+// 阻塞等待用的事件：等待方先登记再复查条件，通知方发布数据后只在有人登记时才进入内核
+typedef struct {
+    atomic_uint seq;                // futex 字，每次唤醒加一
+    atomic_int waiting;
+} ring_event_t;
+
+// 生产者和消费者各自的索引放在不同缓存行上；对方索引的本地缓存只在看起来满/空时才重新读取，
+// 正常情况下两边每批数据只有一次跨核的缓存行传递
+typedef struct {
+    struct {
+        atomic_size_t head;         // 下一个写入位置，只有生产者写
+        size_t cached_tail;         // 生产者看到的 tail
+        ring_event_t not_full;      // 生产者在这里等待
+    } producer CACHE_ALIGNED;
+    struct {
+        atomic_size_t tail;         // 下一个读取位置，只有消费者写
+        size_t cached_head;         // 消费者看到的 head
+        ring_event_t not_empty;     // 消费者在这里等待
+    } consumer CACHE_ALIGNED;
+    size_t mask;
+    uint64_t *slots;
+} spsc_ring_t;
+
+static long futex(atomic_uint *uaddr, int op, unsigned val) {
+    return syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+static int spsc_init(spsc_ring_t *r, size_t capacity) {
+    memset(r, 0, sizeof(*r));
+    r->mask = capacity - 1;
+    return posix_memalign((void **)&r->slots, CACHELINE, sizeof(uint64_t) * capacity);
+}
+
+static void spsc_destroy(spsc_ring_t *r) {
+    free(r->slots);
+}
+
+static void event_notify(ring_event_t *ev) {
+    // 与等待方的“登记后复查”配对：要么这里看到 waiting，要么对方复查时看到新数据
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ev->waiting, memory_order_relaxed)) {
+        atomic_fetch_add(&ev->seq, 1);
+        futex(&ev->seq, FUTEX_WAKE_PRIVATE, 1);
+    }
+}
+
+// ready() 为假时阻塞，直到被 event_notify 唤醒后条件成立
+static void event_wait(ring_event_t *ev, int (*ready)(spsc_ring_t *), spsc_ring_t *r) {
+    for (;;) {
+        unsigned seq = atomic_load(&ev->seq);
+        atomic_store(&ev->waiting, 1);
+        if (ready(r)) {
+            break;
+        }
+        futex(&ev->seq, FUTEX_WAIT_PRIVATE, seq);
+        if (ready(r)) {
+            break;
+        }
+    }
+    atomic_store(&ev->waiting, 0);
+}
+
+// 生产者可写的空位数，必要时刷新 cached_tail
+static size_t spsc_free(spsc_ring_t *r) {
+    size_t head = atomic_load_explicit(&r->producer.head, memory_order_relaxed);
+    size_t capacity = r->mask + 1;
+
+    if (head - r->producer.cached_tail == capacity) {
+        r->producer.cached_tail = atomic_load_explicit(&r->consumer.tail, memory_order_acquire);
+    }
+    return capacity - (head - r->producer.cached_tail);
+}
+
+// 消费者可读的条目数，必要时刷新 cached_head
+static size_t spsc_available(spsc_ring_t *r) {
+    size_t tail = atomic_load_explicit(&r->consumer.tail, memory_order_relaxed);
+
+    if (r->consumer.cached_head == tail) {
+        r->consumer.cached_head = atomic_load_explicit(&r->producer.head, memory_order_acquire);
+    }
+    return r->consumer.cached_head - tail;
+}
+
+static int spsc_has_space(spsc_ring_t *r) { return spsc_free(r) > 0; }
+static int spsc_has_items(spsc_ring_t *r) { return spsc_available(r) > 0; }
+
+// 批量发布：写入最多 n 个条目后只做一次 release 存储，返回实际写入个数（无等待）
+static size_t spsc_push_batch(spsc_ring_t *r, const uint64_t *items, size_t n) {
+    size_t head = atomic_load_explicit(&r->producer.head, memory_order_relaxed);
+    size_t space = spsc_free(r);
+
+    if (n > space) {
+        n = space;
+    }
+    for (size_t i = 0; i < n; i++) {
+        r->slots[(head + i) & r->mask] = items[i];
+    }
+    if (n > 0) {
+        atomic_store_explicit(&r->producer.head, head + n, memory_order_release);
+        event_notify(&r->consumer.not_empty);
+    }
+    return n;
+}
+
+// 批量消费：读出最多 max 个条目后只做一次 release 存储，返回实际读出个数（无等待）
+static size_t spsc_pop_batch(spsc_ring_t *r, uint64_t *items, size_t max) {
+    size_t tail = atomic_load_explicit(&r->consumer.tail, memory_order_relaxed);
+    size_t n = spsc_available(r);
+
+    if (n > max) {
+        n = max;
+    }
+    for (size_t i = 0; i < n; i++) {
+        items[i] = r->slots[(tail + i) & r->mask];
+    }
+    if (n > 0) {
+        atomic_store_explicit(&r->consumer.tail, tail + n, memory_order_release);
+        event_notify(&r->producer.not_full);
+    }
+    return n;
+}
+
+// 阻塞版本：先自旋重试，仍然满/空时在 futex 上睡眠
+static void spsc_push_all(spsc_ring_t *r, const uint64_t *items, size_t n) {
+    int spins = 0;
+
+    while (n > 0) {
+        size_t done = spsc_push_batch(r, items, n);
+        items += done;
+        n -= done;
+        if (n == 0) {
+            break;
+        }
+        if (done > 0) {
+            spins = 0;
+        } else if (++spins >= SPIN_BEFORE_WAIT) {
+            event_wait(&r->producer.not_full, spsc_has_space, r);
+            spins = 0;
+        }
+    }
+}
+
+static size_t spsc_pop_wait(spsc_ring_t *r, uint64_t *items, size_t max) {
+    for (int spins = 0;; spins++) {
+        size_t n = spsc_pop_batch(r, items, max);
+        if (n > 0) {
+            return n;
+        }
+        if (spins >= SPIN_BEFORE_WAIT) {
+            event_wait(&r->consumer.not_empty, spsc_has_items, r);
+            spins = 0;
+        }
+    }
+}
+
+/* ---------------- 基准测试 ---------------- */
+
+// 与上面的演示相同的互斥锁 + 两个条件变量的有界缓冲区，只是容量可配置、去掉了打印和 sleep
+typedef struct {
+    uint64_t *buf;
+    int capacity;
+    int count, in, out;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty, not_full;
+} cv_queue_t;
+
+static void cv_init(cv_queue_t *q, int capacity) {
+    q->buf = malloc(sizeof(uint64_t) * capacity);
+    q->capacity = capacity;
+    q->count = q->in = q->out = 0;
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+}
+
+static void cv_destroy(cv_queue_t *q) {
+    free(q->buf);
+    pthread_mutex_destroy(&q->mutex);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+}
+
+static void cv_push(cv_queue_t *q, uint64_t v) {
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == q->capacity) {
+        pthread_cond_wait(&q->not_full, &q->mutex);
+    }
+    q->buf[q->in] = v;
+    q->in = (q->in + 1) % q->capacity;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->mutex);
+}
+
+static uint64_t cv_pop(cv_queue_t *q) {
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == 0) {
+        pthread_cond_wait(&q->not_empty, &q->mutex);
+    }
+    uint64_t v = q->buf[q->out];
+    q->out = (q->out + 1) % q->capacity;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->mutex);
+    return v;
+}
+
+typedef enum {
+    QUEUE_CONDVAR,
+    QUEUE_SPSC,                     // 逐条发布/消费
+    QUEUE_SPSC_BATCH                // 按 batch 条批量发布/消费
+} queue_kind_t;
+
+// 一条单向通道：生产者把数据写进 to，在 ping-pong 延迟测试中对端再从 back 回写
+typedef struct {
+    queue_kind_t kind;
+    cv_queue_t cv[2];
+    spsc_ring_t ring[2];
+    long items;
+    size_t batch;
+    uint64_t checksum;              // 消费者对收到的值求和，用于校验
+} channel_t;
+
+static void channel_push(channel_t *ch, int dir, uint64_t v) {
+    if (ch->kind == QUEUE_CONDVAR) {
+        cv_push(&ch->cv[dir], v);
+    } else {
+        spsc_push_all(&ch->ring[dir], &v, 1);
+    }
+}
+
+static uint64_t channel_pop(channel_t *ch, int dir) {
+    uint64_t v;
+
+    if (ch->kind == QUEUE_CONDVAR) {
+        return cv_pop(&ch->cv[dir]);
+    }
+    spsc_pop_wait(&ch->ring[dir], &v, 1);
+    return v;
+}
+
+static void *bench_producer(void *arg) {
+    channel_t *ch = (channel_t *)arg;
+
+    if (ch->kind == QUEUE_SPSC_BATCH) {
+        uint64_t batch[BENCH_BATCH];
+        for (long i = 0; i < ch->items; i += (long)ch->batch) {
+            size_t n = ch->items - i < (long)ch->batch ? (size_t)(ch->items - i) : ch->batch;
+            for (size_t j = 0; j < n; j++) {
+                batch[j] = (uint64_t)(i + j);
+            }
+            spsc_push_all(&ch->ring[0], batch, n);
+        }
+    } else {
+        for (long i = 0; i < ch->items; i++) {
+            channel_push(ch, 0, (uint64_t)i);
+        }
+    }
+    return NULL;
+}
+
+static void *bench_consumer(void *arg) {
+    channel_t *ch = (channel_t *)arg;
+    uint64_t sum = 0;
+
+    if (ch->kind == QUEUE_SPSC_BATCH) {
+        uint64_t batch[BENCH_BATCH];
+        for (long got = 0; got < ch->items;) {
+            size_t n = spsc_pop_wait(&ch->ring[0], batch, ch->batch);
+            for (size_t j = 0; j < n; j++) {
+                sum += batch[j];
+            }
+            got += (long)n;
+        }
+    } else {
+        for (long i = 0; i < ch->items; i++) {
+            sum += channel_pop(ch, 0);
+        }
+    }
+    ch->checksum = sum;
+    return NULL;
+}
+
+// ping-pong 的回显端：收到什么就原样写回
+static void *echo_thread(void *arg) {
+    channel_t *ch = (channel_t *)arg;
+
+    for (long i = 0; i < ch->items; i++) {
+        channel_push(ch, 1, channel_pop(ch, 0));
+    }
+    return NULL;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void channel_init(channel_t *ch, queue_kind_t kind, long items, size_t batch) {
+    ch->kind = kind;
+    ch->items = items;
+    ch->batch = batch;
+    for (int d = 0; d < 2; d++) {
+        cv_init(&ch->cv[d], RING_CAPACITY);
+        if (spsc_init(&ch->ring[d], RING_CAPACITY) != 0) {
+            perror("posix_memalign");
+            exit(1);
+        }
+    }
+}
+
+static void channel_destroy(channel_t *ch) {
+    for (int d = 0; d < 2; d++) {
+        cv_destroy(&ch->cv[d]);
+        spsc_destroy(&ch->ring[d]);
+    }
+}
+
+static void bench_queue(const char *label, queue_kind_t kind, long items, size_t batch) {
+    channel_t ch;
+    pthread_t prod, cons;
+    uint64_t start, elapsed;
+    uint64_t *rtt = malloc(sizeof(uint64_t) * LATENCY_ROUNDS);
+
+    // 吞吐量：生产者连续写 items 条，消费者读完为止
+    channel_init(&ch, kind, items, batch);
+    start = now_ns();
+    pthread_create(&cons, NULL, bench_consumer, &ch);
+    pthread_create(&prod, NULL, bench_producer, &ch);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+    elapsed = now_ns() - start;
+    int ok = ch.checksum == (uint64_t)items * (items - 1) / 2;
+    channel_destroy(&ch);
+
+    // 延迟：一条消息发过去再被回显回来，往返时间的一半近似单向延迟
+    channel_init(&ch, kind == QUEUE_SPSC_BATCH ? QUEUE_SPSC : kind, LATENCY_ROUNDS, 1);
+    pthread_create(&cons, NULL, echo_thread, &ch);
+    for (long i = 0; i < LATENCY_ROUNDS; i++) {
+        uint64_t t0 = now_ns();
+        channel_push(&ch, 0, (uint64_t)i);
+        channel_pop(&ch, 1);
+        rtt[i] = now_ns() - t0;
+    }
+    pthread_join(cons, NULL);
+    channel_destroy(&ch);
+    qsort(rtt, LATENCY_ROUNDS, sizeof(uint64_t), cmp_u64);
+
+    printf("%-16s %12.2f %10.1f %10.1f %10.1f%s\n", label, items / (elapsed / 1e9) / 1e6,
+           rtt[LATENCY_ROUNDS / 2] / 2.0 / 1000, rtt[LATENCY_ROUNDS * 99 / 100] / 2.0 / 1000,
+           rtt[LATENCY_ROUNDS - 1] / 2.0 / 1000, ok ? "" : " 校验失败!");
+    free(rtt);
+}
+
+static void bench(long items, size_t batch) {
+    char label[32];
+
+    printf("吞吐量: %ld 条，队列容量 %d；延迟: %d 次 ping-pong 往返的一半\n", items,
+           RING_CAPACITY, LATENCY_ROUNDS);
+    printf("%-16s %12s %10s %10s %10s\n", "队列", "百万条/秒", "p50(us)", "p99(us)", "max(us)");
+    bench_queue("互斥锁+条件变量", QUEUE_CONDVAR, items, 1);
+    bench_queue("SPSC 环形队列", QUEUE_SPSC, items, 1);
+    snprintf(label, sizeof(label), "SPSC 批量(%zu)", batch);
+    bench_queue(label, QUEUE_SPSC_BATCH, items, batch);
+}
+
+int main(int argc, char *argv[]) {
     pthread_t producer_thread, consumer_thread;
-    
+
+    // bench [条目数] [批大小]：与无 sleep 的条件变量版本比较吞吐量和延迟
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        long items = argc > 2 ? atol(argv[2]) : BENCH_ITEMS;
+        long batch = argc > 3 ? atol(argv[3]) : BENCH_BATCH;
+        if (items < 1 || batch < 1 || batch > BENCH_BATCH) {
+            fprintf(stderr, "用法: %s bench [条目数] [批大小(1-%d)]\n", argv[0], BENCH_BATCH);
+            return 1;
+        }
+        bench(items, (size_t)batch);
+        return 0;
+    }
+
     pthread_create(&producer_thread, NULL, producer, NULL);
     pthread_create(&consumer_thread, NULL, consumer, NULL);
-    
+
     pthread_join(producer_thread, NULL);
     pthread_join(consumer_thread, NULL);
-    
+
     return 0;
 }
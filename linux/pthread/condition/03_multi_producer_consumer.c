@@ -1,83 +1,426 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
 #define BUFFER_SIZE 10
 #define PRODUCER_COUNT 3
 #define CONSUMER_COUNT 3
+#define ITEMS_PER_PRODUCER 10
 
-int buffer[BUFFER_SIZE];
-int count = 0;
-int in = 0, out = 0;
+#define CACHELINE 64
+#define CACHE_ALIGNED __attribute__((aligned(CACHELINE)))
+#define SPIN_BEFORE_WAIT 64         // 阻塞前先自旋重试的次数
+#define BENCH_CAPACITY 1024
+#define BENCH_ITEMS 1000000
+#define BENCH_MAX_THREADS 64
 
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t not_empty = PTHREAD_COND_INITIALIZER;
-pthread_cond_t not_full = PTHREAD_COND_INITIALIZER;
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+/* ---------------- 互斥锁 + 条件变量的有界缓冲区 ---------------- */
+
+// 所有生产者和消费者争用同一把锁；not_full/not_empty 分开，signal 只唤醒对应的一方
+typedef struct {
+    int *buf;
+    int capacity;
+    int count, in, out;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty, not_full;
+} cv_queue_t;
+
+static void *cv_create(size_t capacity) {
+    cv_queue_t *q = malloc(sizeof(cv_queue_t));
+
+    if (q == NULL) {
+        return NULL;
+    }
+    q->buf = malloc(sizeof(int) * capacity);
+    if (q->buf == NULL) {
+        free(q);
+        return NULL;
+    }
+    q->capacity = (int)capacity;
+    q->count = q->in = q->out = 0;
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    return q;
+}
+
+static void cv_destroy(void *arg) {
+    cv_queue_t *q = (cv_queue_t *)arg;
+
+    pthread_mutex_destroy(&q->mutex);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->buf);
+    free(q);
+}
+
+static void cv_push(void *arg, int item) {
+    cv_queue_t *q = (cv_queue_t *)arg;
+
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == q->capacity) {
+        pthread_cond_wait(&q->not_full, &q->mutex);
+    }
+    q->buf[q->in] = item;
+    q->in = (q->in + 1) % q->capacity;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->mutex);
+}
+
+static int cv_pop(void *arg) {
+    cv_queue_t *q = (cv_queue_t *)arg;
+
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == 0) {
+        pthread_cond_wait(&q->not_empty, &q->mutex);
+    }
+    int item = q->buf[q->out];
+    q->out = (q->out + 1) % q->capacity;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->mutex);
+    return item;
+}
+
+/* ---------------- Vyukov 有界无锁 MPMC 队列 ---------------- */
+
+// 每个槽位带一个序号：seq == pos 表示可写，seq == pos + 1 表示可读，
+// 读完后置为 pos + capacity 留给下一圈的写者。生产者和消费者只在各自的位置计数器上 CAS，
+// 不同槽位之间互不干扰
+typedef struct {
+    atomic_size_t seq;
+    int data;
+} mpmc_cell_t;
+
+// 阻塞等待的事件：等待方登记后再尝试一次，通知方在有登记者时才进入内核唤醒一个
+typedef struct {
+    atomic_uint seq;                // futex 字
+    atomic_int waiters;
+} queue_event_t;
+
+typedef struct {
+    atomic_size_t enqueue_pos CACHE_ALIGNED;
+    atomic_size_t dequeue_pos CACHE_ALIGNED;
+    queue_event_t not_full CACHE_ALIGNED;
+    queue_event_t not_empty CACHE_ALIGNED;
+    size_t mask;
+    mpmc_cell_t *cells;
+} mpmc_queue_t;
+
+static void *mpmc_create(size_t capacity) {
+    mpmc_queue_t *q;
+    size_t size = 2;
+
+    // 下标用按位与取模，容量向上取到 2 的幂
+    while (size < capacity) {
+        size <<= 1;
+    }
+    if (posix_memalign((void **)&q, CACHELINE, sizeof(mpmc_queue_t)) != 0) {
+        return NULL;
+    }
+    memset(q, 0, sizeof(*q));
+    q->mask = size - 1;
+    q->cells = malloc(sizeof(mpmc_cell_t) * size);
+    if (q->cells == NULL) {
+        free(q);
+        return NULL;
+    }
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&q->cells[i].seq, i);
+    }
+    return q;
+}
+
+static void mpmc_destroy(void *arg) {
+    mpmc_queue_t *q = (mpmc_queue_t *)arg;
+
+    free(q->cells);
+    free(q);
+}
+
+// 非阻塞入队，队列满时返回 0
+static int mpmc_try_push(mpmc_queue_t *q, int item) {
+    size_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    mpmc_cell_t *cell;
+
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    cell->data = item;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 1;
+}
+
+// 非阻塞出队，队列空时返回 0
+static int mpmc_try_pop(mpmc_queue_t *q, int *item) {
+    size_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    mpmc_cell_t *cell;
+
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    *item = cell->data;
+    atomic_store_explicit(&cell->seq, pos + q->mask + 1, memory_order_release);
+    return 1;
+}
+
+static long futex(atomic_uint *uaddr, int op, unsigned val) {
+    return syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+static void event_notify(queue_event_t *ev) {
+    // 与等待方的“登记后重试”配对：要么这里看到登记，要么对方重试时看到这次改动
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ev->waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add(&ev->seq, 1);
+        futex(&ev->seq, FUTEX_WAKE_PRIVATE, 1);
+    }
+}
+
+static void mpmc_push(void *arg, int item) {
+    mpmc_queue_t *q = (mpmc_queue_t *)arg;
+
+    for (int spins = 0; !mpmc_try_push(q, item); spins++) {
+        if (spins < SPIN_BEFORE_WAIT) {
+            cpu_relax();
+            continue;
+        }
+        unsigned seq = atomic_load(&q->not_full.seq);
+        atomic_fetch_add(&q->not_full.waiters, 1);
+        if (mpmc_try_push(q, item)) {
+            atomic_fetch_sub(&q->not_full.waiters, 1);
+            break;
+        }
+        futex(&q->not_full.seq, FUTEX_WAIT_PRIVATE, seq);
+        atomic_fetch_sub(&q->not_full.waiters, 1);
+        spins = 0;
+    }
+    event_notify(&q->not_empty);
+}
+
+static int mpmc_pop(void *arg) {
+    mpmc_queue_t *q = (mpmc_queue_t *)arg;
+    int item;
+
+    for (int spins = 0; !mpmc_try_pop(q, &item); spins++) {
+        if (spins < SPIN_BEFORE_WAIT) {
+            cpu_relax();
+            continue;
+        }
+        unsigned seq = atomic_load(&q->not_empty.seq);
+        atomic_fetch_add(&q->not_empty.waiters, 1);
+        if (mpmc_try_pop(q, &item)) {
+            atomic_fetch_sub(&q->not_empty.waiters, 1);
+            break;
+        }
+        futex(&q->not_empty.seq, FUTEX_WAIT_PRIVATE, seq);
+        atomic_fetch_sub(&q->not_empty.waiters, 1);
+        spins = 0;
+    }
+    event_notify(&q->not_full);
+    return item;
+}
+
+/* ---------------- 固定条目数的运行与校验 ---------------- */
+
+typedef struct {
+    const char *name;
+    void *(*create)(size_t capacity);
+    void (*destroy)(void *q);
+    void (*push)(void *q, int item);
+    int (*pop)(void *q);
+} queue_ops_t;
+
+static const queue_ops_t queues[] = {
+    {"互斥锁+条件变量", cv_create, cv_destroy, cv_push, cv_pop},
+    {"无锁 MPMC", mpmc_create, mpmc_destroy, mpmc_push, mpmc_pop},
+};
+
+#define QUEUE_KINDS (int)(sizeof(queues) / sizeof(queues[0]))
+
+typedef struct {
+    const queue_ops_t *ops;
+    void *queue;
+    atomic_uchar *seen;             // 每个条目被消费的次数，结束后应全部为 1
+    int verbose;
+} run_t;
+
+typedef struct {
+    run_t *run;
+    int id;
+    int first, count;               // 生产者：生产 [first, first + count)；消费者：消费 count 个
+} worker_t;
 
 void *producer(void *arg) {
-    int id = (int)(long)arg;
-    int item = 0;
-    
-    while (1) {
-        pthread_mutex_lock(&mutex);
-        
-        while (count == BUFFER_SIZE) {
-            printf("生产者 %d: 缓冲区满，等待\n", id);
-            pthread_cond_wait(&not_full, &mutex);
+    worker_t *w = (worker_t *)arg;
+    run_t *run = w->run;
+
+    for (int item = w->first; item < w->first + w->count; item++) {
+        run->ops->push(run->queue, item);
+        if (run->verbose) {
+            printf("生产者 %d: 生产 %d\n", w->id, item);
         }
-        
-        buffer[in] = item;
-        printf("生产者 %d: 生产 %d\n", id, item);
-        in = (in + 1) % BUFFER_SIZE;
-        count++;
-        item++;
-        
-        pthread_cond_signal(&not_empty);
-        pthread_mutex_unlock(&mutex);
-        
-        sleep(1);
     }
     return NULL;
 }
 
 void *consumer(void *arg) {
-    int id = (int)(long)arg;
-    
-    while (1) {
-        pthread_mutex_lock(&mutex);
-        
-        while (count == 0) {
-            printf("消费者 %d: 缓冲区空，等待\n", id);
-            pthread_cond_wait(&not_empty, &mutex);
+    worker_t *w = (worker_t *)arg;
+    run_t *run = w->run;
+
+    for (int i = 0; i < w->count; i++) {
+        int item = run->ops->pop(run->queue);
+        atomic_fetch_add_explicit(&run->seen[item], 1, memory_order_relaxed);
+        if (run->verbose) {
+            printf("消费者 %d: 消费 %d\n", w->id, item);
         }
-        
-        int item = buffer[out];
-        printf("消费者 %d: 消费 %d\n", id, item);
-        out = (out + 1) % BUFFER_SIZE;
-        count--;
-        
-        pthread_cond_signal(&not_full);
-        pthread_mutex_unlock(&mutex);
-        
-        sleep(1);
     }
     return NULL;
 }
 
-int main() {
-    pthread_t producers[PRODUCER_COUNT];
-    pthread_t consumers[CONSUMER_COUNT];
-    
-    for (int i = 0; i < PRODUCER_COUNT; i++) {
-        pthread_create(&producers[i], NULL, producer, (void *)(long)i);
+// 生产者合计生产 total 个互不相同的条目，消费者按份额合计取走 total 个；
+// 返回耗时（秒），*exact 置为每个条目是否恰好被消费一次
+static double run_queue(const queue_ops_t *ops, int producers, int consumers, int total,
+                        size_t capacity, int verbose, int *exact) {
+    run_t run = {ops, ops->create(capacity), calloc(total, sizeof(atomic_uchar)), verbose};
+    pthread_t *tids = malloc(sizeof(pthread_t) * (producers + consumers));
+    worker_t *workers = malloc(sizeof(worker_t) * (producers + consumers));
+    struct timespec start, end;
+
+    if (run.queue == NULL || run.seen == NULL || tids == NULL || workers == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < consumers; i++) {
+        worker_t *w = &workers[producers + i];
+        w->run = &run;
+        w->id = i;
+        w->first = 0;
+        w->count = (int)((long)total * (i + 1) / consumers - (long)total * i / consumers);
+        pthread_create(&tids[producers + i], NULL, consumer, w);
+    }
+    for (int i = 0; i < producers; i++) {
+        worker_t *w = &workers[i];
+        w->run = &run;
+        w->id = i;
+        w->first = (int)((long)total * i / producers);
+        w->count = (int)((long)total * (i + 1) / producers) - w->first;
+        pthread_create(&tids[i], NULL, producer, w);
+    }
+    for (int i = 0; i < producers + consumers; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    *exact = 1;
+    for (int i = 0; i < total; i++) {
+        if (atomic_load(&run.seen[i]) != 1) {
+            *exact = 0;
+            break;
+        }
     }
-    
-    for (int i = 0; i < CONSUMER_COUNT; i++) {
-        pthread_create(&consumers[i], NULL, consumer, (void *)(long)i);
+
+    ops->destroy(run.queue);
+    free(run.seen);
+    free(tids);
+    free(workers);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// 生产者和消费者数从 1 翻倍到 max_threads，比较两种队列的吞吐量
+static void bench(int max_threads, int total) {
+    printf("每组 %d 个条目，队列容量 %d，单位: 百万条/秒\n", total, BENCH_CAPACITY);
+    printf("%-14s", "生产者x消费者");
+    for (int k = 0; k < QUEUE_KINDS; k++) {
+        printf(" %16s", queues[k].name);
     }
-    
-    // 让程序运行一段时间
-    sleep(30);
-    
+    printf("\n");
+
+    for (int n = 1; n <= max_threads; n *= 2) {
+        char label[32];
+        snprintf(label, sizeof(label), "%dx%d", n, n);
+        printf("%-14s", label);
+        for (int k = 0; k < QUEUE_KINDS; k++) {
+            int exact;
+            double t = run_queue(&queues[k], n, n, total, BENCH_CAPACITY, 0, &exact);
+            printf(" %16.2f%s", total / t / 1e6, exact ? "" : "(校验失败!)");
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    // bench [最大生产者/消费者数] [条目数]
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int max_threads = argc > 2 ? atoi(argv[2]) : BENCH_MAX_THREADS;
+        int total = argc > 3 ? atoi(argv[3]) : BENCH_ITEMS;
+        if (max_threads < 1 || total < 1) {
+            fprintf(stderr, "用法: %s bench [最大生产者/消费者数] [条目数]\n", argv[0]);
+            return 1;
+        }
+        bench(max_threads, total);
+        return 0;
+    }
+
+    // 每个生产者生产固定数量的条目，全部消费完后检查每个条目恰好被消费一次
+    for (int k = 0; k < QUEUE_KINDS; k++) {
+        int exact;
+        printf("=== %s ===\n", queues[k].name);
+        run_queue(&queues[k], PRODUCER_COUNT, CONSUMER_COUNT,
+                  PRODUCER_COUNT * ITEMS_PER_PRODUCER, BUFFER_SIZE, 1, &exact);
+        printf("%d 个条目%s\n\n", PRODUCER_COUNT * ITEMS_PER_PRODUCER,
+               exact ? "全部恰好消费一次" : "校验失败：有条目丢失或重复");
+    }
+
     return 0;
-}
\ No newline at end of file
+}
@@ -1,140 +1,744 @@
 #include <stdio.h>
+#include <math.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdatomic.h>
+#include <string.h>
 #include <time.h>
 #include <stdlib.h>
 
-#define ITERATIONS 1000000
-#define THREADS 4
+#include "perf_counters.h"
+
+#define THREADS "4"             // 默认线程数列表
+#define TRIALS 5                // 每组参数的正式试验次数（另有一次预热）
+#define DURATION_MS 200         // 每次试验的运行时长
+#define MAX_SWEEP 32            // 每个扫描参数最多的取值个数
+#define BACKOFF_MIN 4           // TTAS 锁退避的初始/最大自旋次数
+#define BACKOFF_MAX 1024
+#define CACHELINE 64
+#define CACHE_ALIGNED __attribute__((aligned(CACHELINE)))
+
+// 票据锁：按取号顺序进入，天然 FIFO 公平
+typedef struct {
+    atomic_uint next;
+    atomic_uint serving;
+} ticket_lock_t;
+
+// test-and-test-and-set 锁：先只读自旋，锁看起来空闲时才尝试交换，失败后指数退避
+typedef struct {
+    atomic_int locked;
+} ttas_lock_t;
+
+// MCS 锁：每个线程在自己的节点上自旋，释放时只通知后继
+typedef struct mcs_node {
+    _Atomic(struct mcs_node *) next;
+    atomic_int locked;
+} mcs_node_t;
+
+typedef struct {
+    _Atomic(mcs_node_t *) tail;
+} mcs_lock_t;
+
+// CLH 锁：每个线程在前驱的节点上自旋，释放后接管前驱节点供下次使用
+typedef struct {
+    atomic_int locked;
+} clh_node_t;
 
-// 测试数据结构
 typedef struct {
-    pthread_mutex_t mutex;
-    pthread_spinlock_t spinlock;
-    pthread_rwlock_t rwlock;
-    sem_t semaphore;
-    int counter;
+    _Atomic(clh_node_t *) tail;
+} clh_lock_t;
+
+// 测试数据结构；ALIGN 为空时是紧凑布局，各原语和计数器挤在相邻的缓存行里
+#define TEST_DATA_FIELDS(ALIGN)                                                         \
+    pthread_mutex_t mutex ALIGN;                                                        \
+    pthread_spinlock_t spinlock ALIGN;                                                  \
+    pthread_rwlock_t rwlock ALIGN;                                                      \
+    sem_t semaphore ALIGN;                                                              \
+    ticket_lock_t ticket ALIGN;                                                         \
+    ttas_lock_t ttas ALIGN;                                                             \
+    mcs_lock_t mcs ALIGN;                                                               \
+    clh_lock_t clh ALIGN;                                                               \
+    long counter ALIGN;                                                                 \
+    atomic_long atomic_counter ALIGN;   /* 无锁原语直接原子递增这个计数器 */
+
+typedef struct {
+    TEST_DATA_FIELDS()
 } test_data_t;
 
-// 互斥锁测试
-void *test_mutex(void *arg) {
-    test_data_t *data = (test_data_t *)arg;
-    
-    for (int i = 0; i < ITERATIONS; i++) {
-        pthread_mutex_lock(&data->mutex);
-        data->counter++;
-        pthread_mutex_unlock(&data->mutex);
+// 填充布局：每个成员独占一条缓存行
+typedef struct {
+    TEST_DATA_FIELDS(CACHE_ALIGNED)
+} padded_test_data_t;
+
+typedef enum {
+    LAYOUT_PACKED,
+    LAYOUT_PADDED
+} layout_t;
+
+static const char *layout_names[] = {"packed", "padded"};
+
+// 一次试验实际使用的同步对象，指向其中一种布局的成员
+typedef struct {
+    pthread_mutex_t *mutex;
+    pthread_spinlock_t *spinlock;
+    pthread_rwlock_t *rwlock;
+    sem_t *semaphore;
+    ticket_lock_t *ticket;
+    ttas_lock_t *ttas;
+    mcs_lock_t *mcs;
+    clh_lock_t *clh;
+    long *counter;
+    atomic_long *atomic_counter;
+} sync_refs_t;
+
+#define BIND_REFS(refs, d)                              \
+    do {                                                \
+        (refs)->mutex = &(d)->mutex;                    \
+        (refs)->spinlock = &(d)->spinlock;              \
+        (refs)->rwlock = &(d)->rwlock;                  \
+        (refs)->semaphore = &(d)->semaphore;            \
+        (refs)->ticket = &(d)->ticket;                  \
+        (refs)->ttas = &(d)->ttas;                      \
+        (refs)->mcs = &(d)->mcs;                        \
+        (refs)->clh = &(d)->clh;                        \
+        (refs)->counter = &(d)->counter;                \
+        (refs)->atomic_counter = &(d)->atomic_counter;  \
+    } while (0)
+
+typedef struct worker worker_t;
+
+// 被测同步原语：name 用于 CSV/JSON，label 用于文本输出
+// lock 为 NULL 表示无锁原语，由 increment 完成计数；thread_init/thread_fini 可选，用于准备每线程的队列节点
+typedef struct {
+    const char *name;
+    const char *label;
+    void (*lock)(worker_t *w);
+    void (*unlock)(worker_t *w);
+    void (*increment)(worker_t *w);
+    void (*thread_init)(worker_t *w);
+    void (*thread_fini)(worker_t *w);
+} primitive_t;
+
+// 一次试验的共享状态
+typedef struct {
+    sync_refs_t data;
+    layout_t layout;
+    const primitive_t *prim;
+    long cs_units;              // 临界区内的工作量
+    long outside_units;         // 两次加锁之间在锁外的工作量
+    char *shards;               // 分片计数器，线程 i 的分片位于 shards + i * shard_stride
+    size_t shard_stride;        // 紧凑布局下分片相邻，填充布局下每片独占缓存行
+    int packed_nodes;           // MCS/CLH 队列节点紧挨着分配，只用于伪共享对比的紧凑一栏
+    pthread_barrier_t start;
+    int stop;
+} run_t;
+
+struct worker {
+    run_t *run;
+    int id;
+    long ops;
+    pthread_t tid;
+    mcs_node_t *mcs;            // 指向独占缓存行的节点，或紧凑对照时的 mcs_node
+    mcs_node_t mcs_node;        // 与相邻线程的 worker 挤在同一片内存里
+    clh_node_t *clh;            // 当前持有的 CLH 节点
+    clh_node_t *clh_pred;       // 加锁时的前驱节点，解锁后成为自己的节点
+};
+
+typedef enum {
+    FORMAT_TEXT,
+    FORMAT_CSV,
+    FORMAT_JSON
+} output_format_t;
+
+// 一组参数的统计结果
+typedef struct {
+    double median;              // ops/s 的中位数
+    double stddev;              // ops/s 的样本标准差
+    double fairness;            // 各线程操作数的 Jain 公平性指数均值，1 表示完全均匀
+    int ok;                     // 所有试验的计数器都与操作数一致
+    double ipc;                 // 以下来自性能计数器，按全部正式试验汇总，不可用时为 NAN
+    double llc_per_op;
+    double branch_per_op;
+    double switches_per_sec;    // 每秒上下文切换次数，反映线程睡眠/唤醒的频率
+} result_t;
+
+static perf_counters_t perf;
+
+static void lock_mutex(worker_t *w) { pthread_mutex_lock(w->run->data.mutex); }
+static void unlock_mutex(worker_t *w) { pthread_mutex_unlock(w->run->data.mutex); }
+static void lock_spin(worker_t *w) { pthread_spin_lock(w->run->data.spinlock); }
+static void unlock_spin(worker_t *w) { pthread_spin_unlock(w->run->data.spinlock); }
+// 读写锁只测写锁
+static void lock_rwlock(worker_t *w) { pthread_rwlock_wrlock(w->run->data.rwlock); }
+static void unlock_rwlock(worker_t *w) { pthread_rwlock_unlock(w->run->data.rwlock); }
+static void lock_sem(worker_t *w) { sem_wait(w->run->data.semaphore); }
+static void unlock_sem(worker_t *w) { sem_post(w->run->data.semaphore); }
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static void lock_ticket(worker_t *w) {
+    ticket_lock_t *l = w->run->data.ticket;
+    unsigned me = atomic_fetch_add_explicit(&l->next, 1, memory_order_relaxed);
+
+    while (atomic_load_explicit(&l->serving, memory_order_acquire) != me) {
+        cpu_relax();
     }
-    
-    return NULL;
 }
 
-// 自旋锁测试
-void *test_spinlock(void *arg) {
-    test_data_t *data = (test_data_t *)arg;
-    
-    for (int i = 0; i < ITERATIONS; i++) {
-        pthread_spin_lock(&data->spinlock);
-        data->counter++;
-        pthread_spin_unlock(&data->spinlock);
+static void unlock_ticket(worker_t *w) {
+    ticket_lock_t *l = w->run->data.ticket;
+    unsigned cur = atomic_load_explicit(&l->serving, memory_order_relaxed);
+
+    atomic_store_explicit(&l->serving, cur + 1, memory_order_release);
+}
+
+static void lock_ttas(worker_t *w) {
+    ttas_lock_t *l = w->run->data.ttas;
+    int backoff = BACKOFF_MIN;
+
+    for (;;) {
+        while (atomic_load_explicit(&l->locked, memory_order_relaxed)) {
+            cpu_relax();
+        }
+        if (!atomic_exchange_explicit(&l->locked, 1, memory_order_acquire)) {
+            return;
+        }
+        for (int i = 0; i < backoff; i++) {
+            cpu_relax();
+        }
+        if (backoff < BACKOFF_MAX) {
+            backoff *= 2;
+        }
+    }
+}
+
+static void unlock_ttas(worker_t *w) {
+    atomic_store_explicit(&w->run->data.ttas->locked, 0, memory_order_release);
+}
+
+// 队列节点上有其他线程的写入（MCS 的 next、CLH 的 locked），默认每个节点独占一条缓存行，
+// 否则相邻线程的节点互相伪共享，测到的就不只是锁算法本身了
+static void *queue_node_new(size_t size, int packed) {
+    void *node;
+
+    if (packed) {
+        node = calloc(1, size);
+    } else if (posix_memalign(&node, CACHELINE, CACHELINE) == 0) {
+        memset(node, 0, CACHELINE);
+    } else {
+        node = NULL;
     }
-    
-    return NULL;
+    if (node == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    return node;
 }
 
-// 读写锁测试（写锁）
-void *test_rwlock(void *arg) {
-    test_data_t *data = (test_data_t *)arg;
-    
-    for (int i = 0; i < ITERATIONS; i++) {
-        pthread_rwlock_wrlock(&data->rwlock);
-        data->counter++;
-        pthread_rwlock_unlock(&data->rwlock);
+static void lock_mcs(worker_t *w) {
+    mcs_lock_t *l = w->run->data.mcs;
+    mcs_node_t *me = w->mcs;
+
+    atomic_store_explicit(&me->next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&me->locked, 1, memory_order_relaxed);
+    mcs_node_t *pred = atomic_exchange_explicit(&l->tail, me, memory_order_acq_rel);
+    if (pred != NULL) {
+        atomic_store_explicit(&pred->next, me, memory_order_release);
+        while (atomic_load_explicit(&me->locked, memory_order_acquire)) {
+            cpu_relax();
+        }
+    }
+}
+
+static void unlock_mcs(worker_t *w) {
+    mcs_lock_t *l = w->run->data.mcs;
+    mcs_node_t *me = w->mcs;
+    mcs_node_t *next = atomic_load_explicit(&me->next, memory_order_acquire);
+
+    if (next == NULL) {
+        // 没有后继：尝试把队尾复位为空；失败说明有线程正在入队，等它挂上 next
+        mcs_node_t *expected = me;
+        if (atomic_compare_exchange_strong_explicit(&l->tail, &expected, NULL,
+                                                    memory_order_release,
+                                                    memory_order_relaxed)) {
+            return;
+        }
+        while ((next = atomic_load_explicit(&me->next, memory_order_acquire)) == NULL) {
+            cpu_relax();
+        }
+    }
+    atomic_store_explicit(&next->locked, 0, memory_order_release);
+}
+
+static void lock_clh(worker_t *w) {
+    clh_lock_t *l = w->run->data.clh;
+
+    atomic_store_explicit(&w->clh->locked, 1, memory_order_relaxed);
+    w->clh_pred = atomic_exchange_explicit(&l->tail, w->clh, memory_order_acq_rel);
+    while (atomic_load_explicit(&w->clh_pred->locked, memory_order_acquire)) {
+        cpu_relax();
+    }
+}
+
+static void unlock_clh(worker_t *w) {
+    atomic_store_explicit(&w->clh->locked, 0, memory_order_release);
+    w->clh = w->clh_pred;
+}
+
+static void mcs_thread_init(worker_t *w) {
+    w->mcs = w->run->packed_nodes ? &w->mcs_node : queue_node_new(sizeof(mcs_node_t), 0);
+}
+
+static void mcs_thread_fini(worker_t *w) {
+    if (w->mcs != &w->mcs_node) {
+        free(w->mcs);
+    }
+}
+
+// CLH 节点在线程间流转：退出时释放自己当前持有的节点，留在队尾的那个由锁本身持有
+static void clh_thread_init(worker_t *w) {
+    w->clh = queue_node_new(sizeof(clh_node_t), w->run->packed_nodes);
+}
+
+static void clh_thread_fini(worker_t *w) {
+    free(w->clh);
+}
+
+static void increment_atomic(worker_t *w) {
+    atomic_fetch_add(w->run->data.atomic_counter, 1);
+}
+
+static atomic_long *shard_of(run_t *run, int id) {
+    return (atomic_long *)(run->shards + id * run->shard_stride);
+}
+
+// 分片计数器：每个线程只写自己的分片，读取时把所有分片加起来
+static void increment_sharded(worker_t *w) {
+    atomic_long *shard = shard_of(w->run, w->id);
+
+    atomic_store_explicit(shard, atomic_load_explicit(shard, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+static long sharded_read(run_t *run, int threads) {
+    long sum = 0;
+
+    for (int i = 0; i < threads; i++) {
+        sum += atomic_load_explicit(shard_of(run, i), memory_order_relaxed);
+    }
+    return sum;
+}
+
+static const primitive_t primitives[] = {
+    {"mutex", "互斥锁", lock_mutex, unlock_mutex, NULL, NULL, NULL},
+    {"spinlock", "自旋锁", lock_spin, unlock_spin, NULL, NULL, NULL},
+    {"rwlock", "读写锁", lock_rwlock, unlock_rwlock, NULL, NULL, NULL},
+    {"semaphore", "信号量", lock_sem, unlock_sem, NULL, NULL, NULL},
+    {"atomic", "原子加", NULL, NULL, increment_atomic, NULL, NULL},
+    {"sharded", "分片计数", NULL, NULL, increment_sharded, NULL, NULL},
+    {"ticket", "票据锁", lock_ticket, unlock_ticket, NULL, NULL, NULL},
+    {"ttas", "TTAS退避", lock_ttas, unlock_ttas, NULL, NULL, NULL},
+    {"mcs", "MCS锁", lock_mcs, unlock_mcs, NULL, mcs_thread_init, mcs_thread_fini},
+    {"clh", "CLH锁", lock_clh, unlock_clh, NULL, clh_thread_init, clh_thread_fini},
+};
+
+#define PRIMITIVES ((int)(sizeof(primitives) / sizeof(primitives[0])))
+
+// 模拟一段工作：每个单位是一次不能被编译器优化掉的 volatile 更新
+static void burn(long units) {
+    volatile unsigned x = 1;
+
+    for (long i = 0; i < units; i++) {
+        x = x * 1103515245u + 12345u;
     }
-    
-    return NULL;
 }
 
-// 信号量测试
-void *test_semaphore(void *arg) {
-    test_data_t *data = (test_data_t *)arg;
-    
-    for (int i = 0; i < ITERATIONS; i++) {
-        sem_wait(&data->semaphore);
-        data->counter++;
-        sem_post(&data->semaphore);
+static void *worker_thread(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    run_t *run = w->run;
+    const primitive_t *prim = run->prim;
+
+    if (prim->thread_init != NULL) {
+        prim->thread_init(w);
+    }
+
+    pthread_barrier_wait(&run->start);
+    while (!__atomic_load_n(&run->stop, __ATOMIC_RELAXED)) {
+        if (prim->lock != NULL) {
+            prim->lock(w);
+            (*run->data.counter)++;
+            burn(run->cs_units);
+            prim->unlock(w);
+        } else {
+            prim->increment(w);
+            burn(run->cs_units);
+        }
+        w->ops++;
+        burn(run->outside_units);
+    }
+
+    if (prim->thread_fini != NULL) {
+        prim->thread_fini(w);
     }
-    
     return NULL;
 }
 
-// 性能测试函数
-double run_test(void *(*test_func)(void *), test_data_t *data) {
-    pthread_t threads[THREADS];
-    struct timespec start, end;
-    
-    data->counter = 0;
-    
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    
-    for (int i = 0; i < THREADS; i++) {
-        pthread_create(&threads[i], NULL, test_func, data);
+// 运行一次试验，返回总吞吐量（ops/s），*fairness 为本次的 Jain 公平性指数，*ops 为总操作数；
+// 计数器与各线程操作数之和不一致时 *ok 置 0。性能计数器覆盖从创建线程到全部 join 的区间
+static double run_trial(run_t *run, int threads, int duration_ms, int *ok, double *fairness,
+                        long *ops) {
+    // 工作线程结构体里有每线程递增的 ops，填充布局下同样让每个线程独占缓存行
+    size_t stride = run->layout == LAYOUT_PADDED
+                        ? (sizeof(worker_t) + CACHELINE - 1) / CACHELINE * CACHELINE
+                        : sizeof(worker_t);
+    void *worker_mem, *shard_mem;
+    struct timespec start, end, pause = {duration_ms / 1000, duration_ms % 1000 * 1000000L};
+    long total = 0;
+    double square_sum = 0;
+
+    run->shard_stride = run->layout == LAYOUT_PADDED ? CACHELINE : sizeof(atomic_long);
+    if (posix_memalign(&worker_mem, CACHELINE, stride * threads) != 0 ||
+        posix_memalign(&shard_mem, CACHELINE, run->shard_stride * threads) != 0) {
+        perror("posix_memalign");
+        exit(1);
+    }
+    memset(worker_mem, 0, stride * threads);
+    memset(shard_mem, 0, run->shard_stride * threads);
+    run->shards = shard_mem;
+
+    *run->data.counter = 0;
+    atomic_store(run->data.atomic_counter, 0);
+    run->stop = 0;
+    pthread_barrier_init(&run->start, NULL, threads + 1);
+
+#define WORKER(i) ((worker_t *)((char *)worker_mem + (i) * stride))
+    perf_counters_start(&perf);
+    for (int i = 0; i < threads; i++) {
+        WORKER(i)->run = run;
+        WORKER(i)->id = i;
+        pthread_create(&WORKER(i)->tid, NULL, worker_thread, WORKER(i));
     }
-    
-    for (int i = 0; i < THREADS; i++) {
-        pthread_join(threads[i], NULL);
+
+    pthread_barrier_wait(&run->start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    nanosleep(&pause, NULL);
+    __atomic_store_n(&run->stop, 1, __ATOMIC_RELAXED);
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(WORKER(i)->tid, NULL);
+        total += WORKER(i)->ops;
+        square_sum += (double)WORKER(i)->ops * WORKER(i)->ops;
     }
-    
+#undef WORKER
+
     clock_gettime(CLOCK_MONOTONIC, &end);
-    
-    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    perf_counters_stop(&perf);
+    pthread_barrier_destroy(&run->start);
+
+    if (*run->data.counter + atomic_load(run->data.atomic_counter) +
+            sharded_read(run, threads) != total) {
+        *ok = 0;
+    }
+    *fairness = square_sum > 0 ? (double)total * total / (threads * square_sum) : 1;
+    *ops = total;
+    free(worker_mem);
+    free(shard_mem);
+    return total / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// 一次预热 + trials 次正式试验，统计中位数和标准差
+static result_t measure(run_t *run, int threads, int trials, int duration_ms) {
+    double samples[trials];
+    double sum = 0, var = 0, fairness, seconds = 0, total_ops = 0;
+    perf_counters_t acc = perf;     // 沿用各计数器的可用状态，只累加数值
+    result_t r = {0, 0, 0, 1, NAN, NAN, NAN, NAN};
+    long ops;
+
+    memset(acc.value, 0, sizeof(acc.value));
+    run_trial(run, threads, duration_ms, &r.ok, &fairness, &ops);
+    for (int t = 0; t < trials; t++) {
+        samples[t] = run_trial(run, threads, duration_ms, &r.ok, &fairness, &ops);
+        sum += samples[t];
+        r.fairness += fairness / trials;
+        seconds += ops / samples[t];
+        total_ops += ops;
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            acc.value[e] += perf.value[e];
+        }
+    }
+    r.ipc = perf_counters_ipc(&acc);
+    r.llc_per_op = perf_counters_per_op(&acc, PERF_LLC_MISSES, total_ops);
+    r.branch_per_op = perf_counters_per_op(&acc, PERF_BRANCH_MISSES, total_ops);
+    r.switches_per_sec = perf_counters_per_op(&acc, PERF_CONTEXT_SWITCHES, seconds);
+    for (int t = 0; t < trials; t++) {
+        var += (samples[t] - sum / trials) * (samples[t] - sum / trials);
+    }
+
+    qsort(samples, trials, sizeof(double), cmp_double);
+    r.median = trials % 2 ? samples[trials / 2]
+                          : (samples[trials / 2 - 1] + samples[trials / 2]) / 2;
+    r.stddev = trials > 1 ? sqrt(var / (trials - 1)) : 0;
+    return r;
+}
+
+// 解析逗号分隔的非负整数列表，返回个数，出错返回 -1
+static int parse_list(const char *s, long *out, long min) {
+    int n = 0;
+    char *end;
+
+    while (*s != '\0' && n < MAX_SWEEP) {
+        out[n] = strtol(s, &end, 10);
+        if (end == s || out[n] < min || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        n++;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n > 0 && *s == '\0' ? n : -1;
+}
+
+static int parse_format(const char *s, output_format_t *format) {
+    static const char *names[] = {"text", "csv", "json"};
+
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(s, names[i]) == 0) {
+            *format = (output_format_t)i;
+            return 0;
+        }
+    }
+    return -1;
 }
 
-int main() {
+// 把可能为 NAN 的计数器指标格式化到 buf；missing 是不可用时的占位（CSV 为空，JSON 为 null）
+static const char *metric(char *buf, size_t len, const char *fmt, double v, const char *missing) {
+    if (isnan(v)) {
+        return missing;
+    }
+    snprintf(buf, len, fmt, v);
+    return buf;
+}
+
+static void print_header(output_format_t format) {
+    if (format == FORMAT_CSV) {
+        printf("primitive,threads,cs_units,outside_units,trials,median_ops_per_sec,"
+               "stddev_ops_per_sec,ops_per_sec_per_thread,fairness,ok,"
+               "ipc,llc_misses_per_op,branch_misses_per_op,context_switches_per_sec\n");
+    } else if (format == FORMAT_JSON) {
+        printf("[\n");
+    } else {
+        printf("%-8s %4s %8s %8s %14s %12s %14s %8s %10s %6s %10s %10s %10s\n", "原语", "线程",
+               "临界区", "锁外", "中位数(ops/s)", "标准差", "每线程(ops/s)", "公平性",
+               "相对互斥锁", "IPC", "LLC/操作", "分支/操作", "切换/秒");
+    }
+}
+
+static void print_result(output_format_t format, const primitive_t *prim, int threads, long cs,
+                         long outside, int trials, const result_t *r, double baseline,
+                         int first) {
+    const char *missing = format == FORMAT_CSV ? "" : format == FORMAT_JSON ? "null" : "-";
+    char ipc_buf[32], llc_buf[32], branch_buf[32], switches_buf[32];
+    const char *ipc = metric(ipc_buf, sizeof(ipc_buf), "%.2f", r->ipc, missing);
+    const char *llc = metric(llc_buf, sizeof(llc_buf), "%.4f", r->llc_per_op, missing);
+    const char *branch = metric(branch_buf, sizeof(branch_buf), "%.4f", r->branch_per_op, missing);
+    const char *switches = metric(switches_buf, sizeof(switches_buf), "%.0f", r->switches_per_sec,
+                                  missing);
+
+    if (format == FORMAT_CSV) {
+        printf("%s,%d,%ld,%ld,%d,%.0f,%.0f,%.0f,%.4f,%d,%s,%s,%s,%s\n", prim->name, threads, cs,
+               outside, trials, r->median, r->stddev, r->median / threads, r->fairness, r->ok,
+               ipc, llc, branch, switches);
+    } else if (format == FORMAT_JSON) {
+        printf("%s  {\"primitive\": \"%s\", \"threads\": %d, \"cs_units\": %ld, "
+               "\"outside_units\": %ld, \"trials\": %d, \"median_ops_per_sec\": %.0f, "
+               "\"stddev_ops_per_sec\": %.0f, \"ops_per_sec_per_thread\": %.0f, "
+               "\"fairness\": %.4f, \"ok\": %s, \"ipc\": %s, \"llc_misses_per_op\": %s, "
+               "\"branch_misses_per_op\": %s, \"context_switches_per_sec\": %s}",
+               first ? "" : ",\n", prim->name, threads, cs, outside, trials, r->median,
+               r->stddev, r->median / threads, r->fairness, r->ok ? "true" : "false",
+               ipc, llc, branch, switches);
+    } else {
+        printf("%-8s %4d %8ld %8ld %14.0f %12.0f %14.0f %8.3f %9.2fx %6s %10s %10s %10s%s\n",
+               prim->label, threads, cs, outside, r->median, r->stddev, r->median / threads,
+               r->fairness, r->median / baseline, ipc, llc, branch, switches,
+               r->ok ? "" : " 计数错误!");
+    }
+    fflush(stdout);
+}
+
+// 初始化/销毁一种布局中的所有同步对象
+#define TEST_DATA_INIT(d)                                                               \
+    do {                                                                                \
+        pthread_mutex_init(&(d)->mutex, NULL);                                          \
+        pthread_spin_init(&(d)->spinlock, PTHREAD_PROCESS_PRIVATE);                     \
+        pthread_rwlock_init(&(d)->rwlock, NULL);                                        \
+        sem_init(&(d)->semaphore, 0, 1);                                                \
+        atomic_init(&(d)->ticket.next, 0);                                              \
+        atomic_init(&(d)->ticket.serving, 0);                                           \
+        atomic_init(&(d)->ttas.locked, 0);                                              \
+        atomic_init(&(d)->mcs.tail, NULL);                                              \
+        atomic_init(&(d)->clh.tail, queue_node_new(sizeof(clh_node_t), 0)); /* 初始队尾是空闲节点 */ \
+    } while (0)
+
+#define TEST_DATA_DESTROY(d)                                                            \
+    do {                                                                                \
+        pthread_mutex_destroy(&(d)->mutex);                                             \
+        pthread_spin_destroy(&(d)->spinlock);                                           \
+        pthread_rwlock_destroy(&(d)->rwlock);                                           \
+        sem_destroy(&(d)->semaphore);                                                   \
+        free(atomic_load(&(d)->clh.tail));                                              \
+    } while (0)
+
+static int parse_layout(const char *s, layout_t *layout) {
+    for (int i = 0; i < 2; i++) {
+        if (strcmp(s, layout_names[i]) == 0) {
+            *layout = (layout_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void bind_layout(run_t *run, layout_t layout, test_data_t *packed,
+                        padded_test_data_t *padded) {
+    run->layout = layout;
+    run->packed_nodes = 0;
+    if (layout == LAYOUT_PADDED) {
+        BIND_REFS(&run->data, padded);
+    } else {
+        BIND_REFS(&run->data, packed);
+    }
+}
+
+// 伪共享对比：同样的原语分别在紧凑布局和填充布局下运行
+static void bench_layout(run_t *run, test_data_t *packed, padded_test_data_t *padded,
+                         int threads, int trials, int duration_ms) {
+    printf("伪共享对比: %d 线程，紧凑布局 %zu 字节，填充布局 %zu 字节\n", threads,
+           sizeof(test_data_t), sizeof(padded_test_data_t));
+    printf("------------------------------------------------\n");
+    printf("%-8s %16s %16s %8s %14s %14s\n", "原语", "紧凑(ops/s)", "填充(ops/s)", "提升",
+           "紧凑 LLC/操作", "填充 LLC/操作");
+
+    run->cs_units = 0;
+    run->outside_units = 0;
+    for (int p = 0; p < PRIMITIVES; p++) {
+        result_t r[2];
+        run->prim = &primitives[p];
+        for (int l = 0; l < 2; l++) {
+            bind_layout(run, (layout_t)l, packed, padded);
+            run->packed_nodes = l == LAYOUT_PACKED;
+            r[l] = measure(run, threads, trials, duration_ms);
+        }
+        char llc[2][32];
+        printf("%-8s %16.0f %16.0f %7.2fx %14s %14s%s\n", run->prim->label, r[0].median,
+               r[1].median, r[1].median / r[0].median,
+               metric(llc[0], sizeof(llc[0]), "%.4f", r[0].llc_per_op, "-"),
+               metric(llc[1], sizeof(llc[1]), "%.4f", r[1].llc_per_op, "-"),
+               r[0].ok && r[1].ok ? "" : " 计数错误!");
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    long thread_list[MAX_SWEEP], cs_list[MAX_SWEEP], outside_list[MAX_SWEEP];
+    int n_threads, n_cs = 1, n_outside = 1;
+    int trials = TRIALS, duration_ms = DURATION_MS, first = 1;
+    output_format_t format = FORMAT_TEXT;
+    layout_t layout = LAYOUT_PACKED;
     test_data_t data;
-    double time_mutex, time_spinlock, time_rwlock, time_semaphore;
-    
+    static padded_test_data_t padded;
+    run_t run;
+
     // 初始化同步机制
-    pthread_mutex_init(&data.mutex, NULL);
-    pthread_spin_init(&data.spinlock, PTHREAD_PROCESS_PRIVATE);
-    pthread_rwlock_init(&data.rwlock, NULL);
-    sem_init(&data.semaphore, 0, 1);
-    
-    printf("性能测试: %d 线程，每线程 %d 次迭代\n", THREADS, ITERATIONS);
-    printf("------------------------------------------------\n");
-    
-    // 测试互斥锁
-    time_mutex = run_test(test_mutex, &data);
-    printf("互斥锁:   计数器 = %d, 时间 = %.3f 秒\n", 
-           data.counter, time_mutex);
-    
-    // 测试自旋锁
-    time_spinlock = run_test(test_spinlock, &data);
-    printf("自旋锁:   计数器 = %d, 时间 = %.3f 秒\n", 
-           data.counter, time_spinlock);
-    
-    // 测试读写锁
-    time_rwlock = run_test(test_rwlock, &data);
-    printf("读写锁:   计数器 = %d, 时间 = %.3f 秒\n", 
-           data.counter, time_rwlock);
-    
-    // 测试信号量
-    time_semaphore = run_test(test_semaphore, &data);
-    printf("信号量:   计数器 = %d, 时间 = %.3f 秒\n", 
-           data.counter, time_semaphore);
-    
-    printf("------------------------------------------------\n");
-    printf("相对性能:\n");
-    printf("互斥锁:   1.00x (基准)\n");
-    printf("自旋锁:   %.2fx\n", time_mutex / time_spinlock);
-    printf("读写锁:   %.2fx\n", time_mutex / time_rwlock);
-    printf("信号量:   %.2fx\n", time_mutex / time_semaphore);
-    
+    TEST_DATA_INIT(&data);
+    TEST_DATA_INIT(&padded);
+    // 计数器不可用时相关列显示为 "-"（CSV 为空，JSON 为 null），吞吐量测量不受影响
+    perf_counters_open(&perf);
+
+    if (argc > 1 && strcmp(argv[1], "layout") == 0) {
+        int threads = argc > 2 ? atoi(argv[2]) : 4;
+        if (argc > 3) {
+            trials = atoi(argv[3]);
+        }
+        if (argc > 4) {
+            duration_ms = atoi(argv[4]);
+        }
+        if (threads < 1 || trials < 1 || duration_ms < 1) {
+            fprintf(stderr, "用法: %s layout [线程数] [试验次数] [每次毫秒数]\n", argv[0]);
+            return 1;
+        }
+        bench_layout(&run, &data, &padded, threads, trials, duration_ms);
+        perf_counters_close(&perf);
+        TEST_DATA_DESTROY(&data);
+        TEST_DATA_DESTROY(&padded);
+        return 0;
+    }
+
+    cs_list[0] = outside_list[0] = 0;
+    n_threads = parse_list(THREADS, thread_list, 1);
+    if ((argc > 1 && (n_threads = parse_list(argv[1], thread_list, 1)) < 0) ||
+        (argc > 2 && (n_cs = parse_list(argv[2], cs_list, 0)) < 0) ||
+        (argc > 3 && (n_outside = parse_list(argv[3], outside_list, 0)) < 0) ||
+        (argc > 4 && parse_format(argv[4], &format) != 0) ||
+        (argc > 5 && (trials = atoi(argv[5])) < 1) ||
+        (argc > 6 && (duration_ms = atoi(argv[6])) < 1) ||
+        (argc > 7 && parse_layout(argv[7], &layout) != 0)) {
+        fprintf(stderr, "用法: %s [线程数列表] [临界区长度列表] [锁外工作量列表] "
+                "[text|csv|json] [试验次数] [每次毫秒数] [packed|padded]\n", argv[0]);
+        fprintf(stderr, "      %s layout [线程数] [试验次数] [每次毫秒数]\n", argv[0]);
+        fprintf(stderr, "列表用逗号分隔，例如: %s 1,2,4,8 0,100 0,1000 csv\n", argv[0]);
+        return 1;
+    }
+    bind_layout(&run, layout, &data, &padded);
+
+    if (format == FORMAT_TEXT) {
+        printf("性能测试: 每组参数预热 1 次 + 正式 %d 次，每次 %d 毫秒，%s 布局\n", trials,
+               duration_ms, layout_names[layout]);
+        printf("------------------------------------------------\n");
+    }
+    print_header(format);
+
+    // 按 线程数 × 临界区长度 × 锁外工作量 扫描，每组参数依次测试所有原语
+    for (int t = 0; t < n_threads; t++) {
+        for (int c = 0; c < n_cs; c++) {
+            for (int o = 0; o < n_outside; o++) {
+                double baseline = 0;
+                for (int p = 0; p < PRIMITIVES; p++) {
+                    run.prim = &primitives[p];
+                    run.cs_units = cs_list[c];
+                    run.outside_units = outside_list[o];
+                    result_t r = measure(&run, (int)thread_list[t], trials, duration_ms);
+                    if (p == 0) {
+                        baseline = r.median;
+                    }
+                    print_result(format, run.prim, (int)thread_list[t], cs_list[c],
+                                 outside_list[o], trials, &r, baseline, first);
+                    first = 0;
+                }
+            }
+        }
+    }
+
+    if (format == FORMAT_JSON) {
+        printf("\n]\n");
+    }
+
     // 清理
-    pthread_mutex_destroy(&data.mutex);
-    pthread_spin_destroy(&data.spinlock);
-    pthread_rwlock_destroy(&data.rwlock);
-    sem_destroy(&data.semaphore);
-    
+    TEST_DATA_DESTROY(&data);
+    TEST_DATA_DESTROY(&padded);
+    perf_counters_close(&perf);
+
     return 0;
-}
\ No newline at end of file
+}
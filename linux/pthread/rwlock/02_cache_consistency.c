@@ -1,66 +1,316 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #define DATA_SIZE 1000
 
+#define CACHE_ALIGNED __attribute__((aligned(64)))
+#define MAX_READERS 64
+#define BENCH_WRITES_PER_SEC 100
+#define BENCH_MS 500
+
+// 每次写入都令 data[i] = i * value，所以一致的快照总和必然是 value * 0..DATA_SIZE-1 的和
+#define SNAPSHOT_SUM(value) ((long)(value) * DATA_SIZE * (DATA_SIZE - 1) / 2)
+
 int data[DATA_SIZE];
 pthread_rwlock_t rwlock;
 
-void *reader(void *arg) {
-    int id = (int)(long)arg;
-    int sum = 0;
-    
+/* ---------------- 读写锁：读者也要修改锁内部的读者计数 ---------------- */
+
+static long rwlock_read(int reader) {
+    long sum = 0;
+    (void)reader;
+
     pthread_rwlock_rdlock(&rwlock);
-    
     for (int i = 0; i < DATA_SIZE; i++) {
         sum += data[i];
     }
-    
-    printf("读者 %d: 总和 = %d\n", id, sum);
-    
     pthread_rwlock_unlock(&rwlock);
-    
-    return NULL;
+    return sum;
 }
 
-void *writer(void *arg) {
-    int id = (int)(long)arg;
-    
+static void rwlock_write(int value) {
     pthread_rwlock_wrlock(&rwlock);
-    
     for (int i = 0; i < DATA_SIZE; i++) {
-        data[i] = i * id;
+        data[i] = i * value;
     }
-    
-    printf("写者 %d: 更新数据完成\n", id);
-    
     pthread_rwlock_unlock(&rwlock);
-    
+}
+
+/* ---------------- 顺序锁：读者只读序号，读到一半被写者打断就重试 ---------------- */
+
+// 写者之间用互斥锁串行；序号为奇数表示写入进行中
+static atomic_uint seq CACHE_ALIGNED;
+static pthread_mutex_t seq_writer = PTHREAD_MUTEX_INITIALIZER;
+static int seq_data[DATA_SIZE] CACHE_ALIGNED;
+
+static long seqlock_read(int reader) {
+    long sum;
+    unsigned start;
+    (void)reader;
+
+    do {
+        while ((start = atomic_load_explicit(&seq, memory_order_acquire)) & 1) {
+            sched_yield();
+        }
+        sum = 0;
+        // 读者可能与写者并发访问数据，用 relaxed 原子读避免数据竞争
+        for (int i = 0; i < DATA_SIZE; i++) {
+            sum += __atomic_load_n(&seq_data[i], __ATOMIC_RELAXED);
+        }
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&seq, memory_order_relaxed) != start);
+    return sum;
+}
+
+static void seqlock_write(int value) {
+    pthread_mutex_lock(&seq_writer);
+    unsigned s = atomic_load_explicit(&seq, memory_order_relaxed);
+    atomic_store_explicit(&seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (int i = 0; i < DATA_SIZE; i++) {
+        __atomic_store_n(&seq_data[i], i * value, __ATOMIC_RELAXED);
+    }
+    atomic_store_explicit(&seq, s + 2, memory_order_release);
+    pthread_mutex_unlock(&seq_writer);
+}
+
+/* ---------------- 基于纪元的 RCU：写者发布新副本，宽限期后回收旧副本 ---------------- */
+
+typedef struct {
+    int data[DATA_SIZE];
+} snapshot_t;
+
+// 每个读者独占一条缓存行记录进入临界区时看到的纪元，0 表示不在读；读者不写任何共享变量
+typedef struct {
+    atomic_ulong epoch;
+} CACHE_ALIGNED reader_slot_t;
+
+static snapshot_t *_Atomic current_snapshot;
+static atomic_ulong global_epoch CACHE_ALIGNED = 1;
+static reader_slot_t reader_slots[MAX_READERS];
+static pthread_mutex_t rcu_writer = PTHREAD_MUTEX_INITIALIZER;
+
+static long rcu_read(int reader) {
+    reader_slot_t *slot = &reader_slots[reader];
+    long sum = 0;
+
+    // 先登记纪元再取指针（都是 seq_cst），写者扫描时要么看到登记，要么这里取到的已是新副本
+    atomic_store(&slot->epoch, atomic_load_explicit(&global_epoch, memory_order_relaxed));
+    snapshot_t *snap = atomic_load(&current_snapshot);
+    for (int i = 0; i < DATA_SIZE; i++) {
+        sum += snap->data[i];
+    }
+    atomic_store_explicit(&slot->epoch, 0, memory_order_release);
+    return sum;
+}
+
+// 等待所有在新纪元之前进入的读者离开
+static void rcu_synchronize(void) {
+    unsigned long target = atomic_fetch_add(&global_epoch, 1) + 1;
+
+    for (int i = 0; i < MAX_READERS; i++) {
+        unsigned long e;
+        while ((e = atomic_load(&reader_slots[i].epoch)) != 0 && e < target) {
+            sched_yield();
+        }
+    }
+}
+
+static void rcu_write(int value) {
+    snapshot_t *fresh = malloc(sizeof(snapshot_t));
+
+    if (fresh == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    for (int i = 0; i < DATA_SIZE; i++) {
+        fresh->data[i] = i * value;
+    }
+    pthread_mutex_lock(&rcu_writer);
+    snapshot_t *old = atomic_exchange(&current_snapshot, fresh);
+    rcu_synchronize();
+    pthread_mutex_unlock(&rcu_writer);
+    free(old);
+}
+
+typedef struct {
+    const char *name;
+    long (*read)(int reader);
+    void (*write)(int value);
+} sync_mode_t;
+
+static const sync_mode_t modes[] = {
+    {"读写锁", rwlock_read, rwlock_write},
+    {"顺序锁", seqlock_read, seqlock_write},
+    {"RCU", rcu_read, rcu_write},
+};
+
+#define MODE_COUNT (int)(sizeof(modes) / sizeof(modes[0]))
+
+static const sync_mode_t *mode;
+
+void *reader(void *arg) {
+    int id = (int)(long)arg;
+    long sum = mode->read(id);
+
+    printf("读者 %d: 总和 = %ld\n", id, sum);
+
+    return NULL;
+}
+
+void *writer(void *arg) {
+    int id = (int)(long)arg;
+
+    mode->write(id);
+
+    printf("写者 %d: 更新数据完成\n", id);
+
+    return NULL;
+}
+
+/* ---------------- 读多写少的基准测试 ---------------- */
+
+typedef struct {
+    long reads;
+    long torn;                      // 总和与任何一次写入都对不上的读次数，应为 0
+    int id;
+} CACHE_ALIGNED bench_reader_t;
+
+static atomic_int bench_stop;
+static long bench_writes_per_sec;
+static atomic_long bench_writes;
+
+static void *bench_reader(void *arg) {
+    bench_reader_t *r = (bench_reader_t *)arg;
+
+    while (!atomic_load_explicit(&bench_stop, memory_order_relaxed)) {
+        long sum = mode->read(r->id);
+        // 写入的 value 是非负整数，一致的快照总和一定是 SNAPSHOT_SUM(1) 的整数倍
+        if (sum % SNAPSHOT_SUM(1) != 0) {
+            r->torn++;
+        }
+        r->reads++;
+    }
     return NULL;
 }
 
-int main() {
+// 按固定频率写入；频率为 0 时不写
+static void *bench_writer(void *arg) {
+    struct timespec gap = {0, 0};
+    int value = 1;
+    (void)arg;
+
+    gap.tv_sec = 1 / bench_writes_per_sec;
+    gap.tv_nsec = 1000000000L / bench_writes_per_sec % 1000000000L;
+    while (!atomic_load_explicit(&bench_stop, memory_order_relaxed)) {
+        mode->write(value++);
+        atomic_fetch_add(&bench_writes, 1);
+        nanosleep(&gap, NULL);
+    }
+    return NULL;
+}
+
+static void bench(int max_readers, long writes_per_sec, int ms) {
+    bench_reader_t *readers = aligned_alloc(64, sizeof(bench_reader_t) * MAX_READERS);
+    struct timespec duration = {ms / 1000, (ms % 1000) * 1000000L};
+
+    bench_writes_per_sec = writes_per_sec;
+    printf("每组运行 %d 毫秒，写者每秒写 %ld 次，单位: 百万次读/秒\n", ms, writes_per_sec);
+    printf("%-8s", "读者数");
+    for (int m = 0; m < MODE_COUNT; m++) {
+        printf(" %12s", modes[m].name);
+    }
+    printf("\n");
+
+    for (int n = 1; n <= max_readers; n *= 2) {
+        printf("%-8d", n);
+        for (int m = 0; m < MODE_COUNT; m++) {
+            pthread_t tids[MAX_READERS], wtid;
+            long reads = 0, torn = 0;
+
+            mode = &modes[m];
+            atomic_store(&bench_stop, 0);
+            atomic_store(&bench_writes, 0);
+            memset(readers, 0, sizeof(bench_reader_t) * n);
+            for (int i = 0; i < n; i++) {
+                readers[i].id = i;
+                pthread_create(&tids[i], NULL, bench_reader, &readers[i]);
+            }
+            if (writes_per_sec > 0) {
+                pthread_create(&wtid, NULL, bench_writer, NULL);
+            }
+            nanosleep(&duration, NULL);
+            atomic_store(&bench_stop, 1);
+            for (int i = 0; i < n; i++) {
+                pthread_join(tids[i], NULL);
+                reads += readers[i].reads;
+                torn += readers[i].torn;
+            }
+            if (writes_per_sec > 0) {
+                pthread_join(wtid, NULL);
+            }
+            printf(" %12.3f%s", reads / (ms / 1000.0) / 1e6, torn ? "(读到不一致数据!)" : "");
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+    free(readers);
+}
+
+int main(int argc, char *argv[]) {
     pthread_t threads[4];
-    
+
     pthread_rwlock_init(&rwlock, NULL);
-    
+
     // 初始化数据
     for (int i = 0; i < DATA_SIZE; i++) {
         data[i] = i;
     }
-    
-    // 创建读者和写者
-    pthread_create(&threads[0], NULL, reader, (void *)1);
-    pthread_create(&threads[1], NULL, reader, (void *)2);
-    pthread_create(&threads[2], NULL, writer, (void *)1);
-    pthread_create(&threads[3], NULL, reader, (void *)3);
-    
-    for (int i = 0; i < 4; i++) {
-        pthread_join(threads[i], NULL);
+    seqlock_write(1);
+    current_snapshot = malloc(sizeof(snapshot_t));
+    if (current_snapshot == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    memcpy(current_snapshot->data, data, sizeof(data));
+
+    // bench [最大读者数] [每秒写次数] [每组毫秒数]
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int max_readers = argc > 2 ? atoi(argv[2]) : MAX_READERS;
+        long writes_per_sec = argc > 3 ? atol(argv[3]) : BENCH_WRITES_PER_SEC;
+        int ms = argc > 4 ? atoi(argv[4]) : BENCH_MS;
+        if (max_readers < 1 || max_readers > MAX_READERS || writes_per_sec < 0 || ms < 1) {
+            fprintf(stderr, "用法: %s bench [最大读者数(1-%d)] [每秒写次数] [每组毫秒数]\n",
+                    argv[0], MAX_READERS);
+            return 1;
+        }
+        bench(max_readers, writes_per_sec, ms);
+    } else {
+        for (int m = 0; m < MODE_COUNT; m++) {
+            mode = &modes[m];
+            printf("=== %s ===\n", mode->name);
+
+            // 创建读者和写者
+            pthread_create(&threads[0], NULL, reader, (void *)1);
+            pthread_create(&threads[1], NULL, reader, (void *)2);
+            pthread_create(&threads[2], NULL, writer, (void *)1);
+            pthread_create(&threads[3], NULL, reader, (void *)3);
+
+            for (int i = 0; i < 4; i++) {
+                pthread_join(threads[i], NULL);
+            }
+        }
     }
-    
+
+    free(current_snapshot);
     pthread_rwlock_destroy(&rwlock);
-    
+
     return 0;
-}
\ No newline at end of file
+}
@@ -1,65 +1,313 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
 #define RESOURCE_COUNT 3
 #define THREAD_COUNT 5
 
-sem_t resource_sem;
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-int resources[RESOURCE_COUNT];
+#define CACHE_ALIGNED __attribute__((aligned(64)))
+#define BENCH_RESOURCES 4096
+#define BENCH_MAX_THREADS 64
+#define BENCH_ITERATIONS 200000
+
+/* ---------------- 信号量 + 互斥锁 + 线性扫描 ---------------- */
+
+// 每次获取：sem_wait，加锁扫描空闲槽位；每次释放：加锁清槽位，sem_post
+typedef struct {
+    sem_t sem;
+    pthread_mutex_t mutex;
+    int *resources;                 // 0 表示空闲，否则为持有者编号 + 1
+    int count;
+} sem_pool_t;
+
+static void *sem_pool_create(int count) {
+    sem_pool_t *p = malloc(sizeof(sem_pool_t));
+
+    sem_init(&p->sem, 0, count);
+    pthread_mutex_init(&p->mutex, NULL);
+    p->resources = calloc(count, sizeof(int));
+    p->count = count;
+    return p;
+}
+
+static void sem_pool_destroy(void *arg) {
+    sem_pool_t *p = (sem_pool_t *)arg;
+
+    sem_destroy(&p->sem);
+    pthread_mutex_destroy(&p->mutex);
+    free(p->resources);
+    free(p);
+}
+
+static int sem_pool_acquire(void *arg, int owner) {
+    sem_pool_t *p = (sem_pool_t *)arg;
+    int resource_id = -1;
 
-void *worker(void *arg) {
-    int id = (int)(long)arg;
-    int resource_id;
-    
     // 等待可用资源
-    sem_wait(&resource_sem);
-    
+    sem_wait(&p->sem);
+
     // 分配资源
-    pthread_mutex_lock(&mutex);
-    for (int i = 0; i < RESOURCE_COUNT; i++) {
-        if (resources[i] == 0) {
-            resources[i] = id;
+    pthread_mutex_lock(&p->mutex);
+    for (int i = 0; i < p->count; i++) {
+        if (p->resources[i] == 0) {
+            p->resources[i] = owner + 1;
             resource_id = i;
             break;
         }
     }
-    pthread_mutex_unlock(&mutex);
-    
+    pthread_mutex_unlock(&p->mutex);
+    return resource_id;
+}
+
+static void sem_pool_release(void *arg, int resource_id) {
+    sem_pool_t *p = (sem_pool_t *)arg;
+
+    pthread_mutex_lock(&p->mutex);
+    p->resources[resource_id] = 0;
+    pthread_mutex_unlock(&p->mutex);
+    sem_post(&p->sem);
+}
+
+/* ---------------- 无锁空闲槽位栈 ---------------- */
+
+// 空闲槽位串成一个 Treiber 栈，栈顶是 (版本号 << 32 | 槽位 + 1)，0 表示栈空。
+// 获取和释放各是一次 CAS；版本号每次修改都加一，防止槽位被取走又放回造成的 ABA 问题
+#define TOP_INDEX(top) ((uint32_t)(top))
+#define TOP_MAKE(tag, index) (((uint64_t)(tag) << 32) | (uint32_t)(index))
+
+typedef struct {
+    _Atomic uint64_t top CACHE_ALIGNED;
+    atomic_uint wake_seq CACHE_ALIGNED;    // futex 字，池空时在此等待
+    atomic_int waiters;
+    atomic_uint *next;              // next[i] 为槽位 i 下面那个槽位 + 1
+    int count;
+} lf_pool_t;
+
+static long futex(atomic_uint *uaddr, int op, unsigned val) {
+    return syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+static void *lf_pool_create(int count) {
+    lf_pool_t *p;
+
+    if (posix_memalign((void **)&p, 64, sizeof(lf_pool_t)) != 0) {
+        return NULL;
+    }
+    memset(p, 0, sizeof(*p));
+    p->next = malloc(sizeof(atomic_uint) * count);
+    p->count = count;
+    for (int i = 0; i < count; i++) {
+        atomic_init(&p->next[i], i + 1 < count ? i + 2 : 0);
+    }
+    atomic_init(&p->top, TOP_MAKE(0, count > 0 ? 1 : 0));
+    return p;
+}
+
+static void lf_pool_destroy(void *arg) {
+    lf_pool_t *p = (lf_pool_t *)arg;
+
+    free(p->next);
+    free(p);
+}
+
+// 非阻塞获取，池空时返回 -1
+static int lf_pool_try_acquire(lf_pool_t *p) {
+    uint64_t top = atomic_load_explicit(&p->top, memory_order_acquire);
+
+    while (TOP_INDEX(top) != 0) {
+        uint32_t slot = TOP_INDEX(top) - 1;
+        uint32_t below = atomic_load_explicit(&p->next[slot], memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&p->top, &top,
+                                                  TOP_MAKE((top >> 32) + 1, below),
+                                                  memory_order_acquire,
+                                                  memory_order_acquire)) {
+            return (int)slot;
+        }
+    }
+    return -1;
+}
+
+// 只有池空时才在 futex 上睡眠
+static int lf_pool_acquire(void *arg, int owner) {
+    lf_pool_t *p = (lf_pool_t *)arg;
+    int slot;
+    (void)owner;
+
+    while ((slot = lf_pool_try_acquire(p)) < 0) {
+        unsigned seq = atomic_load(&p->wake_seq);
+        atomic_fetch_add(&p->waiters, 1);
+        // 登记后再试一次，与释放方“压栈后检查登记”配对，不会漏掉唤醒
+        slot = lf_pool_try_acquire(p);
+        if (slot < 0) {
+            futex(&p->wake_seq, FUTEX_WAIT_PRIVATE, seq);
+        }
+        atomic_fetch_sub(&p->waiters, 1);
+        if (slot >= 0) {
+            break;
+        }
+    }
+    return slot;
+}
+
+static void lf_pool_release(void *arg, int resource_id) {
+    lf_pool_t *p = (lf_pool_t *)arg;
+    uint64_t top = atomic_load_explicit(&p->top, memory_order_relaxed);
+
+    do {
+        atomic_store_explicit(&p->next[resource_id], TOP_INDEX(top), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&p->top, &top,
+                                                    TOP_MAKE((top >> 32) + 1, resource_id + 1),
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&p->waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add(&p->wake_seq, 1);
+        futex(&p->wake_seq, FUTEX_WAKE_PRIVATE, 1);
+    }
+}
+
+typedef struct {
+    const char *name;
+    void *(*create)(int count);
+    void (*destroy)(void *pool);
+    int (*acquire)(void *pool, int owner);
+    void (*release)(void *pool, int resource_id);
+} pool_ops_t;
+
+static const pool_ops_t pools[] = {
+    {"信号量+互斥锁", sem_pool_create, sem_pool_destroy, sem_pool_acquire, sem_pool_release},
+    {"无锁槽位栈", lf_pool_create, lf_pool_destroy, lf_pool_acquire, lf_pool_release},
+};
+
+#define POOL_KINDS (int)(sizeof(pools) / sizeof(pools[0]))
+
+static const pool_ops_t *pool_ops;
+static void *pool;
+
+void *worker(void *arg) {
+    int id = (int)(long)arg;
+    int resource_id = pool_ops->acquire(pool, id);
+
     printf("线程 %d: 使用资源 %d\n", id, resource_id);
     sleep(2);
-    
-    // 释放资源
-    pthread_mutex_lock(&mutex);
-    resources[resource_id] = 0;
-    pthread_mutex_unlock(&mutex);
-    
+
     printf("线程 %d: 释放资源 %d\n", id, resource_id);
-    sem_post(&resource_sem);
-    
+    pool_ops->release(pool, resource_id);
+
     return NULL;
 }
 
-int main() {
-    pthread_t threads[THREAD_COUNT];
-    
-    sem_init(&resource_sem, 0, RESOURCE_COUNT);
-    
-    for (int i = 0; i < RESOURCE_COUNT; i++) {
-        resources[i] = 0;
+/* ---------------- 基准测试 ---------------- */
+
+typedef struct {
+    int id;
+    int iterations;
+    atomic_uchar *in_use;           // 校验：同一槽位不能同时被两个线程持有
+    long conflicts;
+} CACHE_ALIGNED bench_worker_t;
+
+static void *bench_worker(void *arg) {
+    bench_worker_t *w = (bench_worker_t *)arg;
+
+    for (int i = 0; i < w->iterations; i++) {
+        int slot = pool_ops->acquire(pool, w->id);
+        if (atomic_exchange_explicit(&w->in_use[slot], 1, memory_order_relaxed) != 0) {
+            w->conflicts++;
+        }
+        atomic_store_explicit(&w->in_use[slot], 0, memory_order_relaxed);
+        pool_ops->release(pool, slot);
+    }
+    return NULL;
+}
+
+static void bench(int resources, int max_threads, int iterations) {
+    bench_worker_t *workers = aligned_alloc(64, sizeof(bench_worker_t) * max_threads);
+    pthread_t *tids = malloc(sizeof(pthread_t) * max_threads);
+    atomic_uchar *in_use = calloc(resources, sizeof(atomic_uchar));
+
+    printf("%d 个资源，每线程获取+释放 %d 次，单位: 百万次/秒\n", resources, iterations);
+    printf("%-8s", "线程数");
+    for (int k = 0; k < POOL_KINDS; k++) {
+        printf(" %16s", pools[k].name);
     }
-    
-    for (int i = 0; i < THREAD_COUNT; i++) {
-        pthread_create(&threads[i], NULL, worker, (void *)(long)i);
+    printf("\n");
+
+    for (int n = 1; n <= max_threads; n *= 2) {
+        printf("%-8d", n);
+        for (int k = 0; k < POOL_KINDS; k++) {
+            struct timespec start, end;
+            long conflicts = 0;
+
+            pool_ops = &pools[k];
+            pool = pool_ops->create(resources);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (int i = 0; i < n; i++) {
+                workers[i].id = i;
+                workers[i].iterations = iterations;
+                workers[i].in_use = in_use;
+                workers[i].conflicts = 0;
+                pthread_create(&tids[i], NULL, bench_worker, &workers[i]);
+            }
+            for (int i = 0; i < n; i++) {
+                pthread_join(tids[i], NULL);
+                conflicts += workers[i].conflicts;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            pool_ops->destroy(pool);
+
+            double t = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+            printf(" %16.2f%s", (double)n * iterations / t / 1e6,
+                   conflicts ? "(槽位重复分配!)" : "");
+        }
+        printf("\n");
+        fflush(stdout);
     }
-    
-    for (int i = 0; i < THREAD_COUNT; i++) {
-        pthread_join(threads[i], NULL);
+    free(workers);
+    free(tids);
+    free(in_use);
+}
+
+int main(int argc, char *argv[]) {
+    pthread_t threads[THREAD_COUNT];
+
+    // bench [资源数] [最大线程数] [每线程次数]
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int resources = argc > 2 ? atoi(argv[2]) : BENCH_RESOURCES;
+        int max_threads = argc > 3 ? atoi(argv[3]) : BENCH_MAX_THREADS;
+        int iterations = argc > 4 ? atoi(argv[4]) : BENCH_ITERATIONS;
+        if (resources < 1 || max_threads < 1 || iterations < 1) {
+            fprintf(stderr, "用法: %s bench [资源数] [最大线程数] [每线程次数]\n", argv[0]);
+            return 1;
+        }
+        bench(resources, max_threads, iterations);
+        return 0;
+    }
+
+    for (int k = 0; k < POOL_KINDS; k++) {
+        pool_ops = &pools[k];
+        pool = pool_ops->create(RESOURCE_COUNT);
+        printf("=== %s ===\n", pool_ops->name);
+
+        for (int i = 0; i < THREAD_COUNT; i++) {
+            pthread_create(&threads[i], NULL, worker, (void *)(long)i);
+        }
+
+        for (int i = 0; i < THREAD_COUNT; i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        pool_ops->destroy(pool);
     }
-    
-    sem_destroy(&resource_sem);
-    
+
     return 0;
-}
\ No newline at end of file
+}
@@ -1,13 +1,43 @@
 #include <stdio.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <time.h>
 
 #define ITERATIONS 10000000
+#define BACKOFF_MAX 1024
+#define SPIN_LIMIT 64          // 票据锁自旋这么多次仍未轮到就让出 CPU
 
-pthread_mutex_t mutex;
-pthread_spinlock_t spinlock;
-int counter_mutex = 0;
-int counter_spin = 0;
+// 每个锁和计数器独占一条缓存行，测量结果里不掺杂相邻变量之间的缓存行乒乓
+// 紧凑与填充布局的吞吐量对比见 performance/01_sync_performance.c 的 layout 模式
+#define CACHE_ALIGNED __attribute__((aligned(64)))
+
+pthread_mutex_t mutex CACHE_ALIGNED;
+pthread_spinlock_t spinlock CACHE_ALIGNED;
+int counter_mutex CACHE_ALIGNED = 0;
+int counter_spin CACHE_ALIGNED = 0;
+
+// 用户态自旋锁：票据锁与带指数退避的 TTAS 锁
+// MCS/CLH 等队列锁以及参数化的对比见 performance/01_sync_performance.c
+// 票据锁的两个字段属于同一把锁，有意放在同一条缓存行里，整体与其他变量隔开
+struct {
+    atomic_uint next;
+    atomic_uint serving;
+} ticket CACHE_ALIGNED;
+atomic_int ttas_locked CACHE_ALIGNED;
+int counter_ticket CACHE_ALIGNED = 0;
+int counter_ttas CACHE_ALIGNED = 0;
+atomic_int counter_atomic CACHE_ALIGNED;
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
 
 void *increment_mutex(void *arg) {
     (void)arg;
@@ -29,46 +59,99 @@ void *increment_spin(void *arg) {
     return NULL;
 }
 
-int main() {
+void *increment_ticket(void *arg) {
+    (void)arg;
+    for (int i = 0; i < ITERATIONS; i++) {
+        unsigned me = atomic_fetch_add_explicit(&ticket.next, 1, memory_order_relaxed);
+        int spins = 0;
+        // 严格 FIFO：线程数超过 CPU 数时，下一个号的持有者可能没在运行，只自旋会白白耗尽时间片
+        while (atomic_load_explicit(&ticket.serving, memory_order_acquire) != me) {
+            if (++spins < SPIN_LIMIT) {
+                cpu_relax();
+            } else {
+                sched_yield();
+            }
+        }
+        counter_ticket++;
+        atomic_store_explicit(&ticket.serving, me + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+void *increment_ttas(void *arg) {
+    (void)arg;
+    for (int i = 0; i < ITERATIONS; i++) {
+        int backoff = 1;
+        // 先只读等待锁空闲，再尝试交换；失败后退避，减少缓存行争抢
+        while (atomic_load_explicit(&ttas_locked, memory_order_relaxed) ||
+               atomic_exchange_explicit(&ttas_locked, 1, memory_order_acquire)) {
+            for (int j = 0; j < backoff; j++) {
+                cpu_relax();
+            }
+            if (backoff < BACKOFF_MAX) {
+                backoff *= 2;
+            }
+        }
+        counter_ttas++;
+        atomic_store_explicit(&ttas_locked, 0, memory_order_release);
+    }
+    return NULL;
+}
+
+void *increment_atomic(void *arg) {
+    (void)arg;
+    for (int i = 0; i < ITERATIONS; i++) {
+        atomic_fetch_add(&counter_atomic, 1);
+    }
+    return NULL;
+}
+
+// 两个线程同时运行 fn，返回耗时
+static double run_pair(void *(*fn)(void *)) {
     pthread_t tid1, tid2;
     struct timespec start, end;
-    double time_mutex, time_spin;
-    
-    // 测试互斥锁
-    pthread_mutex_init(&mutex, NULL);
-    
+
     clock_gettime(CLOCK_MONOTONIC, &start);
-    pthread_create(&tid1, NULL, increment_mutex, NULL);
-    pthread_create(&tid2, NULL, increment_mutex, NULL);
+    pthread_create(&tid1, NULL, fn, NULL);
+    pthread_create(&tid2, NULL, fn, NULL);
     pthread_join(tid1, NULL);
     pthread_join(tid2, NULL);
     clock_gettime(CLOCK_MONOTONIC, &end);
-    
-    time_mutex = (end.tv_sec - start.tv_sec) + 
-                 (end.tv_nsec - start.tv_nsec) / 1e9;
-    
-    printf("互斥锁: 计数器 = %d, 时间 = %.3f 秒\n", 
+
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main() {
+    double time_mutex, time_spin, time_ticket, time_ttas, time_atomic;
+
+    // 测试互斥锁
+    pthread_mutex_init(&mutex, NULL);
+    time_mutex = run_pair(increment_mutex);
+    printf("互斥锁: 计数器 = %d, 时间 = %.3f 秒\n",
            counter_mutex, time_mutex);
-    
     pthread_mutex_destroy(&mutex);
-    
+
     // 测试自旋锁
     pthread_spin_init(&spinlock, PTHREAD_PROCESS_PRIVATE);
-    
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    pthread_create(&tid1, NULL, increment_spin, NULL);
-    pthread_create(&tid2, NULL, increment_spin, NULL);
-    pthread_join(tid1, NULL);
-    pthread_join(tid2, NULL);
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    
-    time_spin = (end.tv_sec - start.tv_sec) + 
-                (end.tv_nsec - start.tv_nsec) / 1e9;
-    
-    printf("自旋锁: 计数器 = %d, 时间 = %.3f 秒\n", 
+    time_spin = run_pair(increment_spin);
+    printf("自旋锁: 计数器 = %d, 时间 = %.3f 秒\n",
            counter_spin, time_spin);
-    
     pthread_spin_destroy(&spinlock);
-    
+
+    // 测试票据锁
+    time_ticket = run_pair(increment_ticket);
+    printf("票据锁: 计数器 = %d, 时间 = %.3f 秒\n",
+           counter_ticket, time_ticket);
+
+    // 测试 TTAS + 指数退避
+    time_ttas = run_pair(increment_ttas);
+    printf("TTAS 锁: 计数器 = %d, 时间 = %.3f 秒\n",
+           counter_ttas, time_ttas);
+
+    // 测试无锁原子加
+    time_atomic = run_pair(increment_atomic);
+    printf("原子加: 计数器 = %d, 时间 = %.3f 秒\n",
+           atomic_load(&counter_atomic), time_atomic);
+
     return 0;
-}
\ No newline at end of file
+}
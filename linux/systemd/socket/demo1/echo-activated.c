@@ -1,71 +1,985 @@
+#define _GNU_SOURCE
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
-#include <poll.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <systemd/sd-daemon.h>
 
-#define BUFSIZE 1024
-#define IDLE_TIMEOUT_SEC 30  // 空闲 30 秒后退出
+// 内核头文件足够新（multishot recv 和 provided buffer ring）时才编译 io_uring 后端，
+// 不依赖 liburing，直接用系统调用操作环形队列
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#if defined(IORING_RECV_MULTISHOT) && defined(__NR_io_uring_setup)
+#define HAVE_IO_URING 1
+#endif
 
-int main() {
-    int n_fds = sd_listen_fds(0);
-    if (n_fds <= 0) {
-        fprintf(stderr, "Not started by systemd socket activation.\n");
-        return EXIT_FAILURE;
+#define BUFSIZE 16384        // epoll 后端每个连接的回显缓冲区
+#define MAX_EVENTS 256
+#define IDLE_TIMEOUT_SEC 30  // 所有 worker 都空闲 30 秒后退出
+#define MAX_WORKERS 256
+#define CACHE_ALIGNED __attribute__((aligned(64)))
+
+// 统计请求路径上的系统调用次数（不含启动时的一次性设置），退出时按回显的数据块折算
+#define COUNTED(w, call) ((w)->syscalls++, (call))
+
+// 每个 worker 线程有自己的监听 socket、事件循环和统计，线程之间不共享连接，
+// 内核按四元组哈希把新连接分到各个监听 socket 的 accept 队列上
+typedef struct {
+    int id;
+    int listen_fd;
+    int cpu;                 // 绑定的 CPU，-1 表示不绑定
+    const char *backend;
+    pthread_t thread;
+    int status;
+    int spare_fd;            // 预留的 fd，fd 用完时腾出来接收并关闭排队的连接
+    int idle;                // 已计入 idle_workers
+    long active_conns;
+    unsigned long long conns, bytes, chunks, syscalls;
+} CACHE_ALIGNED worker_t;
+
+static int n_workers;
+static atomic_int idle_workers;
+static volatile sig_atomic_t stop;
+static sigset_t wait_mask;   // worker 等待事件时临时使用的信号掩码：只放开 SIGUSR1
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+// 超时到期且没有连接时登记为空闲，全部 worker 都空闲后通知主线程退出；
+// 之后有任何活动就取消登记
+static void worker_set_idle(worker_t *w, int idle) {
+    if (w->idle == idle) {
+        return;
+    }
+    w->idle = idle;
+    if (!idle) {
+        atomic_fetch_sub(&idle_workers, 1);
+    } else if (atomic_fetch_add(&idle_workers, 1) + 1 == n_workers) {
+        kill(getpid(), SIGUSR2);
     }
+}
 
-    // systemd 只传递一个 socket，所以使用 fd = SD_LISTEN_FDS_START (=3)
-    int listen_fd = SD_LISTEN_FDS_START;
+/* ---------------- epoll 后端 ---------------- */
 
-    // 允许地址重用（可选）
-    int opt = 1;
-    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+// 每个连接的状态：buffer[off, len) 是已读入、还没写回的数据
+typedef struct {
+    int fd;
+    int read_closed;         // 对端已关闭写方向，回显完剩余数据后关闭连接
+    size_t off;
+    size_t len;
+    char buffer[BUFSIZE];
+} conn_t;
 
-    printf("Echo service started via socket activation. Listening on inherited fd %d...\n", listen_fd);
-    fflush(stdout);
+static void conn_close(worker_t *w, conn_t *c) {
+    COUNTED(w, close(c->fd));  // 关闭 fd 会自动把它从 epoll 中移除
+    free(c);
+    w->active_conns--;
+}
 
+// 边沿触发下每次事件都要把能做的事做完：先写出积压数据，写不动时等待 EPOLLOUT；
+// 缓冲区清空后继续读，直到 EAGAIN 或对端关闭。缓冲区满时暂停读取，形成背压
+static void conn_pump(worker_t *w, conn_t *c) {
     for (;;) {
-        struct pollfd pfd = {
-            .fd = listen_fd,
-            .events = POLLIN
+        while (c->off < c->len) {
+            ssize_t n = COUNTED(w, send(c->fd, c->buffer + c->off, c->len - c->off, MSG_NOSIGNAL));
+            if (n > 0) {
+                c->off += n;
+                w->bytes += n;
+            } else if (n == -1 && errno == EINTR) {
+                continue;
+            } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return;  // 发送缓冲区满，等下一次 EPOLLOUT
+            } else {
+                conn_close(w, c);
+                return;
+            }
+        }
+        c->off = c->len = 0;
+
+        if (c->read_closed) {
+            conn_close(w, c);
+            return;
+        }
+
+        ssize_t n = COUNTED(w, recv(c->fd, c->buffer, sizeof(c->buffer), 0));
+        if (n > 0) {
+            c->len = n;
+            w->chunks++;
+        } else if (n == 0) {
+            c->read_closed = 1;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;  // 数据读完了，等下一次 EPOLLIN
+        } else {
+            conn_close(w, c);
+            return;
+        }
+    }
+}
+
+// 监听 socket 也是边沿触发，一次事件里要 accept 到 EAGAIN 为止
+static void accept_all(worker_t *w, int epfd) {
+    for (;;) {
+        int client_fd = COUNTED(w, accept4(w->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC));
+        if (client_fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if ((errno == EMFILE || errno == ENFILE) && w->spare_fd != -1) {
+                // 边沿触发下直接返回的话，队列里剩下的连接不会再产生事件，只能等下一个新连接；
+                // 腾出预留的 fd 把队头连接接收下来立即关闭，客户端马上得知被拒绝，然后继续清空队列
+                perror("accept4");
+                COUNTED(w, close(w->spare_fd));
+                int fd = COUNTED(w, accept4(w->listen_fd, NULL, NULL, SOCK_CLOEXEC));
+                if (fd != -1) {
+                    COUNTED(w, close(fd));
+                }
+                w->spare_fd = COUNTED(w, open("/dev/null", O_RDONLY | O_CLOEXEC));
+                if (fd != -1) {
+                    continue;
+                }
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept4");
+            }
+            return;
+        }
+
+        // 回显按缓冲区大小分段写回，消息超过一个缓冲区时最后一段不足 MSS，Nagle 会等上一段的 ACK，
+        // 而客户端的延迟 ACK 要约 40 ms 才发，所以关掉 Nagle，每段立即发出
+        int one = 1;
+        COUNTED(w, setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)));
+
+        conn_t *c = malloc(sizeof(conn_t));
+        if (c == NULL) {
+            close(client_fd);
+            continue;
+        }
+        c->fd = client_fd;
+        c->read_closed = 0;
+        c->off = c->len = 0;
+
+        // 读写事件一次注册好，边沿触发下不需要在 EPOLLIN/EPOLLOUT 之间来回修改
+        struct epoll_event ev = {
+            .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+            .data.ptr = c
         };
+        if (COUNTED(w, epoll_ctl(epfd, EPOLL_CTL_ADD, client_fd, &ev)) == -1) {
+            perror("epoll_ctl");
+            close(client_fd);
+            free(c);
+            continue;
+        }
+        w->active_conns++;
+        w->conns++;
+        conn_pump(w, c);  // 连接上可能已经有数据到达
+    }
+}
 
-        // poll() 会阻塞最多 IDLE_TIMEOUT_SEC 秒
-        int ret = poll(&pfd, 1, IDLE_TIMEOUT_SEC * 1000); // 单位：毫秒
+static int run_epoll(worker_t *w) {
+    int listen_fd = w->listen_fd;
+
+    // 继承来的 socket 默认是阻塞的，边沿触发必须配合非阻塞 accept
+    fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd == -1) {
+        perror("epoll_create1");
+        return EXIT_FAILURE;
+    }
+    struct epoll_event lev = {
+        .events = EPOLLIN | EPOLLET,
+        .data.ptr = NULL  // NULL 表示监听 socket
+    };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &lev) == -1) {
+        perror("epoll_ctl");
+        return EXIT_FAILURE;
+    }
+
+    w->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    printf("Worker %d (epoll, cpu %d) listening on fd %d...\n", w->id, w->cpu, listen_fd);
+    fflush(stdout);
+
+    while (!stop) {
+        struct epoll_event events[MAX_EVENTS];
+
+        // epoll_pwait() 会阻塞最多 IDLE_TIMEOUT_SEC 秒，等待期间原子地放开 SIGUSR1，
+        // 主线程发来的停止通知不会在检查 stop 和进入等待之间丢失
+        int ret = COUNTED(w, epoll_pwait(epfd, events, MAX_EVENTS, IDLE_TIMEOUT_SEC * 1000,
+                                         &wait_mask)); // 单位：毫秒
 
         if (ret == -1) {
             if (errno == EINTR) continue; // 被信号中断，重试
-            perror("poll() failed");
+            perror("epoll_wait() failed");
             break;
         }
 
         if (ret == 0) {
-            // 超时！无连接到达
-            fprintf(stderr, "Idle timeout reached, exiting.");
+            // 超时！这段时间没有任何事件；还有连接保持打开时继续等待，不主动断开客户端
+            if (w->active_conns == 0) {
+                worker_set_idle(w, 1);
+            }
+            continue;
+        }
+
+        worker_set_idle(w, 0);
+        for (int i = 0; i < ret; i++) {
+            if (events[i].data.ptr == NULL) {
+                accept_all(w, epfd);
+            } else {
+                conn_pump(w, events[i].data.ptr);
+            }
+        }
+    }
+
+    close(epfd);
+    if (w->spare_fd != -1) {
+        close(w->spare_fd);
+    }
+    return EXIT_SUCCESS;
+}
+
+/* ---------------- io_uring 后端 ---------------- */
+
+#ifdef HAVE_IO_URING
+
+#define URING_ENTRIES 1024
+#define URING_CQ_ENTRIES 8192
+#define BUF_GROUP 0
+#define BUF_COUNT 1024       // provided buffer 个数，必须是 2 的幂
+#define BUF_SIZE 4096
+
+// user_data 的低 3 位是操作类型，其余位是连接指针（accept/timeout/close 为 NULL）
+enum { OP_ACCEPT, OP_RECV, OP_SEND, OP_TIMEOUT, OP_CLOSE, OP_CANCEL };
+#define OP_MASK 7ULL
+
+// 一个连接上的待发送数据是一串 provided buffer，通过 buf_next[] 串成队列，
+// 同一时刻最多一个 sendmsg 在途以保证回显顺序，它用 iovec 一次发出队列中的全部 buffer
+// （最多 CONN_IOV_MAX 个）；发送完的 buffer 立即归还给内核。
+// buffer 由整个 worker 共享，一个只发不收的客户端不能把它们全占住：排队的 buffer 达到
+// CONN_MAX_BUFS 时停止这个连接的接收，等它自己的数据发到 CONN_RESUME_BUFS 以下再恢复
+#define CONN_MAX_BUFS 16
+#define CONN_RESUME_BUFS (CONN_MAX_BUFS / 2)
+#define CONN_IOV_MAX (CONN_MAX_BUFS * 2)  // 取消 recv 之前已在途的数据还会入队，留出余量
+
+typedef struct uconn {
+    int fd;
+    int read_closed;
+    int recv_armed;          // multishot recv 仍在进行
+    int cancel_pending;      // 已请求取消 multishot recv，等它结束
+    int throttled;           // 排队的 buffer 太多，暂停接收
+    int send_inflight;
+    int head, tail;          // 待发送 buffer 队列，-1 表示空
+    int queued;              // 队列中的 buffer 数
+    unsigned send_off;       // 队头 buffer 已发送的字节数
+    struct uconn *next_starved;
+    int starved;             // 因 provided buffer 用完（ENOBUFS）而停止接收
+    struct uconn *next_sender;
+    int send_wanted;         // 本轮收到了新数据，处理完 CQE 后再统一提交 sendmsg
+    struct msghdr msg;       // 在途 sendmsg 使用，完成前必须保持有效
+    struct iovec iov[CONN_IOV_MAX];
+} uconn_t;
+
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+    unsigned sq_local_tail;  // 已填好但还没提交的 SQE 追加在这里
+    unsigned to_submit;
+
+    struct io_uring_buf_ring *buf_ring;
+    unsigned short buf_tail;
+    char *buf_base;
+    int buf_next[BUF_COUNT];
+    unsigned buf_len[BUF_COUNT];
+    int buffers_returned;    // 本轮有 buffer 归还，处理完 CQE 后唤醒饥饿的连接
+    uconn_t *starved;
+    uconn_t *senders;
+
+    int multishot_recv;      // 内核不支持 multishot recv 时退化为每次重新提交
+    struct __kernel_timespec idle_ts;
+    struct timespec last_activity;
+    worker_t *w;
+} uring_t;
+
+// 与 epoll_pwait 一样，等待期间原子地换成 wait_mask；内核的 sigset 大小是 _NSIG / 8
+static int uring_enter(uring_t *u, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)COUNTED(u->w, syscall(__NR_io_uring_enter, u->fd, to_submit, min_complete, flags,
+                                      flags & IORING_ENTER_GETEVENTS ? &wait_mask : NULL,
+                                      _NSIG / 8));
+}
+
+static int uring_init(uring_t *u) {
+    struct io_uring_params p;
+
+    memset(u, 0, sizeof(*u));
+    memset(&p, 0, sizeof(p));
+    // 只有本线程提交，内核可以省掉跨线程同步；旧内核不认识这些标志时去掉重试
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    p.cq_entries = URING_CQ_ENTRIES;
+    u->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if (u->fd < 0 && errno == EINVAL) {
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = URING_CQ_ENTRIES;
+        u->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    }
+    if (u->fd < 0) {
+        return -1;  // ENOSYS、EPERM（io_uring_disabled）等
+    }
+
+    u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_ring_size > u->sq_ring_size) {
+            u->sq_ring_size = u->cq_ring_size;
+        }
+        u->cq_ring_size = u->sq_ring_size;
+    }
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring == MAP_FAILED) {
+        return -1;
+    }
+    u->cq_ring = u->sq_ring;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+        if (u->cq_ring == MAP_FAILED) {
+            return -1;
+        }
+    }
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd,
+                   IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        return -1;
+    }
+
+    u->sq_head = (unsigned *)((char *)u->sq_ring + p.sq_off.head);
+    u->sq_tail = (unsigned *)((char *)u->sq_ring + p.sq_off.tail);
+    u->sq_mask = (unsigned *)((char *)u->sq_ring + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)((char *)u->sq_ring + p.sq_off.array);
+    u->cq_head = (unsigned *)((char *)u->cq_ring + p.cq_off.head);
+    u->cq_tail = (unsigned *)((char *)u->cq_ring + p.cq_off.tail);
+    u->cq_mask = (unsigned *)((char *)u->cq_ring + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)((char *)u->cq_ring + p.cq_off.cqes);
+    // SQE 按顺序填写，索引数组固定为恒等映射
+    for (unsigned i = 0; i < p.sq_entries; i++) {
+        u->sq_array[i] = i;
+    }
+    u->sq_local_tail = *u->sq_tail;
+
+    // 注册 provided buffer ring：内核接收数据时自己挑一个空闲 buffer，不用为每个连接预留
+    u->buf_ring = mmap(NULL, BUF_COUNT * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    u->buf_base = malloc((size_t)BUF_COUNT * BUF_SIZE);
+    if (u->buf_ring == MAP_FAILED || u->buf_base == NULL) {
+        return -1;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (unsigned long)u->buf_ring;
+    reg.ring_entries = BUF_COUNT;
+    reg.bgid = BUF_GROUP;
+    if (syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        return -1;  // 5.19 之前的内核
+    }
+    for (int bid = 0; bid < BUF_COUNT; bid++) {
+        struct io_uring_buf *b = &u->buf_ring->bufs[u->buf_tail++ & (BUF_COUNT - 1)];
+        b->addr = (unsigned long)(u->buf_base + (size_t)bid * BUF_SIZE);
+        b->len = BUF_SIZE;
+        b->bid = bid;
+    }
+    __atomic_store_n(&u->buf_ring->tail, u->buf_tail, __ATOMIC_RELEASE);
+
+    u->multishot_recv = 1;
+    return 0;
+}
+
+static void uring_destroy(uring_t *u) {
+    if (u->sqes && u->sqes != MAP_FAILED) munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring && u->cq_ring != MAP_FAILED && u->cq_ring != u->sq_ring)
+        munmap(u->cq_ring, u->cq_ring_size);
+    if (u->sq_ring && u->sq_ring != MAP_FAILED) munmap(u->sq_ring, u->sq_ring_size);
+    if (u->buf_ring && u->buf_ring != MAP_FAILED)
+        munmap(u->buf_ring, BUF_COUNT * sizeof(struct io_uring_buf));
+    free(u->buf_base);
+    if (u->fd >= 0) close(u->fd);
+}
+
+// 发布已填好的 SQE，批量提交并等待至少 wait 个完成事件，一次系统调用完成两件事
+static int uring_submit(uring_t *u, unsigned wait) {
+    __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+    int ret = uring_enter(u, u->to_submit, wait, wait ? IORING_ENTER_GETEVENTS : 0);
+    if (ret > 0) {
+        u->to_submit -= ret;
+    }
+    return ret;
+}
+
+static struct io_uring_sqe *uring_get_sqe(uring_t *u) {
+    while (u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= URING_ENTRIES) {
+        uring_submit(u, 0);  // 提交队列满了，先把已有的提交出去
+    }
+    struct io_uring_sqe *sqe = &u->sqes[u->sq_local_tail & *u->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_local_tail++;
+    u->to_submit++;
+    return sqe;
+}
+
+static void prep_accept(uring_t *u, int listen_fd) {
+    struct io_uring_sqe *sqe = uring_get_sqe(u);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;  // 一次提交，每来一个连接产生一个完成事件
+    sqe->user_data = OP_ACCEPT;
+}
+
+static void prep_recv(uring_t *u, uconn_t *c) {
+    struct io_uring_sqe *sqe = uring_get_sqe(u);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+    sqe->ioprio = u->multishot_recv ? IORING_RECV_MULTISHOT : 0;
+    sqe->user_data = (uintptr_t)c | OP_RECV;
+    c->recv_armed = 1;
+}
+
+static void prep_send(uring_t *u, uconn_t *c) {
+    // 大消息会占用多个 buffer，逐个 send 要多一个往返的完成事件，所以整条队列一次发出
+    int n = 0;
+    unsigned off = c->send_off;
+    for (int bid = c->head; bid != -1 && n < CONN_IOV_MAX; bid = u->buf_next[bid]) {
+        c->iov[n].iov_base = u->buf_base + (size_t)bid * BUF_SIZE + off;
+        c->iov[n].iov_len = u->buf_len[bid] - off;
+        off = 0;
+        n++;
+    }
+    memset(&c->msg, 0, sizeof(c->msg));
+    c->msg.msg_iov = c->iov;
+    c->msg.msg_iovlen = n;
+
+    struct io_uring_sqe *sqe = uring_get_sqe(u);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = c->fd;
+    sqe->addr = (unsigned long)&c->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uintptr_t)c | OP_SEND;
+    c->send_inflight = 1;
+}
+
+// 按 user_data 取消这个连接上的 multishot recv，recv 随后以 -ECANCELED 结束
+static void prep_cancel_recv(uring_t *u, uconn_t *c) {
+    struct io_uring_sqe *sqe = uring_get_sqe(u);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (uintptr_t)c | OP_RECV;
+    sqe->user_data = OP_CANCEL;
+    c->cancel_pending = 1;
+}
+
+static void prep_timeout(uring_t *u, long sec) {
+    struct io_uring_sqe *sqe = uring_get_sqe(u);
+    u->idle_ts.tv_sec = sec;
+    u->idle_ts.tv_nsec = 0;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = (unsigned long)&u->idle_ts;
+    sqe->len = 1;
+    sqe->user_data = OP_TIMEOUT;
+}
+
+static void prep_close(uring_t *u, int fd) {
+    struct io_uring_sqe *sqe = uring_get_sqe(u);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->user_data = OP_CLOSE;
+}
+
+static void buf_recycle(uring_t *u, int bid) {
+    struct io_uring_buf *b = &u->buf_ring->bufs[u->buf_tail++ & (BUF_COUNT - 1)];
+    b->addr = (unsigned long)(u->buf_base + (size_t)bid * BUF_SIZE);
+    b->len = BUF_SIZE;
+    b->bid = bid;
+    __atomic_store_n(&u->buf_ring->tail, u->buf_tail, __ATOMIC_RELEASE);
+    u->buffers_returned = 1;
+}
+
+// 没有在途操作、读方向已关闭且数据都发完后才能释放连接
+static void uconn_maybe_close(uring_t *u, uconn_t *c) {
+    if (c->read_closed && !c->recv_armed && !c->send_inflight && c->head == -1 && !c->starved &&
+        !c->send_wanted) {
+        prep_close(u, c->fd);
+        free(c);
+        u->w->active_conns--;
+    }
+}
+
+// 根据排队的 buffer 数决定继续、暂停还是恢复这个连接的接收
+static void uconn_update_recv(uring_t *u, uconn_t *c) {
+    if (c->queued >= CONN_MAX_BUFS) {
+        c->throttled = 1;
+    } else if (c->queued <= CONN_RESUME_BUFS) {
+        c->throttled = 0;
+    }
+    if (c->read_closed || c->starved) {
+        return;
+    }
+    if (!c->throttled && !c->recv_armed) {
+        prep_recv(u, c);
+    } else if (c->throttled && c->recv_armed && u->multishot_recv && !c->cancel_pending) {
+        prep_cancel_recv(u, c);  // 取消前已经在途的数据照常入队，超出上限的部分很有限
+    }
+}
+
+static void uconn_fail(uring_t *u, uconn_t *c) {
+    // 丢弃未发送的数据；让仍在进行的 multishot recv 以 EOF 结束，随后走正常的关闭流程
+    while (c->head != -1 && !c->send_inflight) {
+        int bid = c->head;
+        c->head = u->buf_next[bid];
+        c->queued--;
+        buf_recycle(u, bid);
+    }
+    if (c->head == -1) {
+        c->tail = -1;
+    }
+    c->read_closed = 1;
+    if (c->recv_armed) {
+        COUNTED(u->w, shutdown(c->fd, SHUT_RDWR));
+    }
+}
+
+static void handle_recv(uring_t *u, uconn_t *c, struct io_uring_cqe *cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        c->recv_armed = 0;
+        c->cancel_pending = 0;
+    }
+    if (cqe->res > 0) {
+        int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        u->w->chunks++;
+        u->buf_len[bid] = cqe->res;
+        u->buf_next[bid] = -1;
+        if (c->read_closed) {
+            buf_recycle(u, bid);  // 连接出错后收到的数据直接丢弃
+        } else {
+            if (c->tail == -1) {
+                c->head = bid;
+            } else {
+                u->buf_next[c->tail] = bid;
+            }
+            c->tail = bid;
+            c->queued++;
+            // 同一批 CQE 里往往还有这个连接的后续数据（大于 BUF_SIZE 的消息），攒到本轮结束一起发
+            if (!c->send_wanted) {
+                c->send_wanted = 1;
+                c->next_sender = u->senders;
+                u->senders = c;
+            }
+        }
+    } else if (cqe->res == 0) {
+        c->read_closed = 1;
+    } else if (cqe->res == -ENOBUFS) {
+        // 所有 buffer 都在等待发送，暂停接收，有 buffer 归还时再重新提交
+        if (!c->starved) {
+            c->starved = 1;
+            c->next_starved = u->starved;
+            u->starved = c;
+        }
+        return;
+    } else if (cqe->res == -EINVAL && u->multishot_recv) {
+        u->multishot_recv = 0;  // 6.0 之前的内核，改用单次 recv
+    } else if (cqe->res != -ECANCELED) {
+        uconn_fail(u, c);       // -ECANCELED 是 uconn_update_recv 主动暂停接收
+    }
+    uconn_update_recv(u, c);
+    uconn_maybe_close(u, c);
+}
+
+static void handle_send(uring_t *u, uconn_t *c, struct io_uring_cqe *cqe) {
+    c->send_inflight = 0;
+    if (cqe->res < 0) {
+        uconn_fail(u, c);
+    } else {
+        u->w->bytes += cqe->res;
+        // 按发出的字节数从队头依次归还 buffer，最后一个可能只发出了一部分
+        unsigned left = cqe->res;
+        while (left > 0) {
+            unsigned avail = u->buf_len[c->head] - c->send_off;
+            if (left < avail) {
+                c->send_off += left;
+                break;
+            }
+            left -= avail;
+            int bid = c->head;
+            c->head = u->buf_next[bid];
+            if (c->head == -1) {
+                c->tail = -1;
+            }
+            c->send_off = 0;
+            c->queued--;
+            buf_recycle(u, bid);
+        }
+        if (c->head != -1) {
+            prep_send(u, c);  // 还有新入队的数据，或者上次只发出了一部分
+        }
+        uconn_update_recv(u, c);
+    }
+    uconn_maybe_close(u, c);
+}
+
+static double seconds_since(const struct timespec *t) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - t->tv_sec) + (now.tv_nsec - t->tv_nsec) / 1e9;
+}
+
+// 返回 -1 表示内核不支持，调用方改用 epoll 后端
+static int run_uring(worker_t *w) {
+    uring_t *u = malloc(sizeof(uring_t));
+    int listen_fd = w->listen_fd;
+    int status = EXIT_SUCCESS;
+
+    if (u == NULL || uring_init(u) != 0) {
+        if (u != NULL) {
+            uring_destroy(u);
+            free(u);
+        }
+        return -1;
+    }
+    u->w = w;
+
+    prep_accept(u, listen_fd);
+    prep_timeout(u, IDLE_TIMEOUT_SEC);
+    clock_gettime(CLOCK_MONOTONIC, &u->last_activity);
+
+    printf("Worker %d (io_uring, cpu %d) listening on fd %d...\n", w->id, w->cpu, listen_fd);
+    fflush(stdout);
+
+    while (!stop) {
+        if (uring_submit(u, 1) < 0) {
+            if (errno == EINTR) continue; // 被信号中断，重试
+            perror("io_uring_enter() failed");
+            status = EXIT_FAILURE;
             break;
         }
 
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        int client_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &client_len);
-        if (client_fd == -1) {
-            perror("accept");
-            continue;
+        unsigned head = *u->cq_head;
+        unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+            uconn_t *c = (uconn_t *)(uintptr_t)(cqe->user_data & ~OP_MASK);
+
+            switch (cqe->user_data & OP_MASK) {
+            case OP_ACCEPT:
+                if (cqe->res >= 0) {
+                    // 与 epoll 后端相同，关掉 Nagle；这里每段回显最多 BUF_SIZE 字节，不关的话
+                    // 超过 4 KiB 的消息就会卡在延迟 ACK 上
+                    int one = 1;
+                    COUNTED(w, setsockopt(cqe->res, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)));
+                    c = malloc(sizeof(uconn_t));
+                    if (c == NULL) {
+                        prep_close(u, cqe->res);
+                        break;
+                    }
+                    memset(c, 0, sizeof(*c));
+                    c->fd = cqe->res;
+                    c->head = c->tail = -1;
+                    w->active_conns++;
+                    w->conns++;
+                    prep_recv(u, c);
+                } else if (cqe->res == -EINVAL && w->conns == 0) {
+                    status = -1;  // 内核不支持 multishot accept（5.19 之前）
+                } else {
+                    fprintf(stderr, "accept: %s\n", strerror(-cqe->res));
+                }
+                if (status != -1 && !(cqe->flags & IORING_CQE_F_MORE)) {
+                    prep_accept(u, listen_fd);  // multishot 被内核结束了，重新提交
+                }
+                break;
+            case OP_RECV:
+                handle_recv(u, c, cqe);
+                break;
+            case OP_SEND:
+                handle_send(u, c, cqe);
+                break;
+            case OP_TIMEOUT: {
+                // 超时！没有打开的连接且这段时间里没有活动就登记为空闲，然后按剩余时间重新计时
+                long left = IDLE_TIMEOUT_SEC - (long)seconds_since(&u->last_activity);
+                if (w->active_conns == 0 && left <= 0) {
+                    worker_set_idle(w, 1);
+                }
+                prep_timeout(u, left > 0 ? left : IDLE_TIMEOUT_SEC);
+                break;
+            }
+            default:
+                break;
+            }
+            if ((cqe->user_data & OP_MASK) != OP_TIMEOUT) {
+                clock_gettime(CLOCK_MONOTONIC, &u->last_activity);
+                worker_set_idle(w, 0);
+            }
         }
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
 
-        char buffer[BUFSIZE];
-        ssize_t n = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
-        if (n > 0) {
-            buffer[n] = '\0';
-            printf("Received: %s\n", buffer);
-            fflush(stdout);
-            send(client_fd, buffer, n, 0); // echo back
+        while (u->senders != NULL) {
+            uconn_t *c = u->senders;
+            u->senders = c->next_sender;
+            c->send_wanted = 0;
+            if (!c->send_inflight && c->head != -1) {
+                prep_send(u, c);
+            }
+            uconn_maybe_close(u, c);
+        }
+
+        // 有 buffer 归还后，重新为因 ENOBUFS 停止接收的连接提交 recv
+        if (u->buffers_returned) {
+            u->buffers_returned = 0;
+            while (u->starved != NULL) {
+                uconn_t *c = u->starved;
+                u->starved = c->next_starved;
+                c->starved = 0;
+                uconn_update_recv(u, c);
+                uconn_maybe_close(u, c);
+            }
+        }
+
+        if (status == -1) {
+            break;
         }
-        close(client_fd);
     }
 
-    return EXIT_SUCCESS;
+    uring_destroy(u);
+    free(u);
+    return status;
+}
+
+#endif /* HAVE_IO_URING */
+
+// worker 多于 systemd 传来的 socket 时，为它克隆一个绑定到同一地址的 SO_REUSEPORT 监听 socket
+static int clone_listener(int fd) {
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    int one = 1;
+
+    if (getsockname(fd, (struct sockaddr *)&addr, &len) == -1) {
+        return -1;
+    }
+    // 同一端口上的所有 socket 都要打开 SO_REUSEPORT，继承来的那个也补上（单元文件里最好直接写 ReusePort=true）
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+
+    int s = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s == -1) {
+        return -1;
+    }
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    if (addr.ss_family == AF_INET6) {
+        int v6only = 0;
+        socklen_t optlen = sizeof(v6only);
+        getsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, &optlen);
+        setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+    }
+    if (bind(s, (struct sockaddr *)&addr, len) == -1 || listen(s, SOMAXCONN) == -1) {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+// 第 i 个 worker 绑定到进程允许运行的第 i 个 CPU（超过 CPU 数时轮回）
+static int pick_cpu(int i) {
+    cpu_set_t allowed;
+    int count;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || (count = CPU_COUNT(&allowed)) == 0) {
+        return -1;
+    }
+    for (int cpu = 0, k = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed) && k++ == i % count) {
+            return cpu;
+        }
+    }
+    return -1;
+}
+
+static void *worker_main(void *arg) {
+    worker_t *w = arg;
+
+    if (w->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    w->status = -1;
+#ifdef HAVE_IO_URING
+    if (strcmp(w->backend, "epoll") != 0) {
+        w->status = run_uring(w);
+        if (w->status == -1) {
+            fprintf(stderr, "Worker %d: io_uring unavailable, falling back to epoll.\n", w->id);
+        }
+    }
+#else
+    if (strcmp(w->backend, "uring") == 0 && w->id == 0) {
+        fprintf(stderr, "Built without io_uring support, using epoll.\n");
+    }
+#endif
+    if (w->status == -1) {
+        w->status = run_epoll(w);
+    }
+    // 出错提前退出的 worker 也算空闲，所有 worker 都退出时主线程能被唤醒
+    worker_set_idle(w, 1);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    // echo-activated [auto|epoll|uring] [worker 数]
+    // 后端默认 auto：优先 io_uring，内核不支持时退回 epoll；worker 数默认 1，0 表示每个 CPU 一个
+    const char *backend = argc > 1 ? argv[1] : "auto";
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    n_workers = argc > 2 ? atoi(argv[2]) : 1;
+    if (n_workers == 0) {
+        n_workers = cpus > 0 ? (int)cpus : 1;
+    }
+    if ((strcmp(backend, "auto") != 0 && strcmp(backend, "epoll") != 0 &&
+         strcmp(backend, "uring") != 0) || n_workers < 0 || n_workers > MAX_WORKERS) {
+        fprintf(stderr, "Usage: %s [auto|epoll|uring] [workers (0 = one per CPU, max %d)]\n",
+                argv[0], MAX_WORKERS);
+        return EXIT_FAILURE;
+    }
+
+    int n_fds = sd_listen_fds(0);
+    if (n_fds <= 0) {
+        fprintf(stderr, "Not started by systemd socket activation.\n");
+        return EXIT_FAILURE;
+    }
+    // 每个传进来的 socket 都必须有 worker 接收，否则分到它上面的连接没人处理
+    if (n_fds > MAX_WORKERS) {
+        fprintf(stderr, "Too many sockets passed (%d, max %d).\n", n_fds, MAX_WORKERS);
+        return EXIT_FAILURE;
+    }
+    if (n_workers < n_fds) {
+        n_workers = n_fds;
+    }
+
+    // 前 n_fds 个 worker 直接使用 systemd 传来的 fd（SD_LISTEN_FDS_START 起，即 3、4、...），
+    // 其余的 worker 各自克隆一个 SO_REUSEPORT socket
+    worker_t *workers;
+    if (posix_memalign((void **)&workers, 64, sizeof(worker_t) * n_workers) != 0) {
+        perror("posix_memalign");
+        return EXIT_FAILURE;
+    }
+    memset(workers, 0, sizeof(worker_t) * n_workers);
+    for (int i = 0; i < n_workers; i++) {
+        worker_t *w = &workers[i];
+        int opt = 1;
+
+        w->id = i;
+        w->backend = backend;
+        w->cpu = n_workers > 1 ? pick_cpu(i) : -1;
+        if (i < n_fds) {
+            w->listen_fd = SD_LISTEN_FDS_START + i;
+            // 允许地址重用（可选）
+            setsockopt(w->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        } else if ((w->listen_fd = clone_listener(SD_LISTEN_FDS_START)) == -1) {
+            perror("SO_REUSEPORT clone failed, sharing fd 3");
+            w->listen_fd = SD_LISTEN_FDS_START;
+        }
+    }
+
+    // 信号只由主线程用 sigwait 同步接收：SIGTERM（systemctl stop）、SIGINT、SIGUSR2（全部 worker 空闲）。
+    // worker 平时屏蔽所有这些信号，只在等待事件时放开 SIGUSR1，主线程用它把 worker 从等待中叫醒。
+    // SIGUSR1 的处理函数不设 SA_RESTART，让等待返回 EINTR
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGUSR1, &sa, NULL);
+
+    sigset_t block, main_set;
+    sigemptyset(&block);
+    sigaddset(&block, SIGTERM);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGUSR1);
+    sigaddset(&block, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &block, NULL);
+    pthread_sigmask(SIG_SETMASK, NULL, &wait_mask);
+    sigdelset(&wait_mask, SIGUSR1);
+    main_set = block;
+    sigdelset(&main_set, SIGUSR1);
+
+    int started = 0;
+    for (; started < n_workers; started++) {
+        if (pthread_create(&workers[started].thread, NULL, worker_main, &workers[started]) != 0) {
+            perror("pthread_create");
+            stop = 1;
+            break;
+        }
+    }
+
+    int sig = 0;
+    if (!stop) {
+        sigwait(&main_set, &sig);
+        if (sig == SIGUSR2) {
+            fprintf(stderr, "Idle timeout reached, exiting.\n");
+        }
+    }
+    stop = 1;
+    for (int i = 0; i < started; i++) {
+        pthread_kill(workers[i].thread, SIGUSR1);
+    }
+
+    int status = started == n_workers ? EXIT_SUCCESS : EXIT_FAILURE;
+    unsigned long long conns = 0, bytes = 0, chunks = 0, syscalls = 0;
+    for (int i = 0; i < started; i++) {
+        worker_t *w = &workers[i];
+
+        pthread_join(w->thread, NULL);
+        if (w->status != EXIT_SUCCESS) {
+            status = EXIT_FAILURE;
+        }
+        if (n_workers > 1) {
+            printf("Worker %d (fd %d): %llu connections, %llu bytes\n", w->id, w->listen_fd,
+                   w->conns, w->bytes);
+        }
+        conns += w->conns;
+        bytes += w->bytes;
+        chunks += w->chunks;
+        syscalls += w->syscalls;
+    }
+
+    printf("Served %llu connections with %d workers, echoed %llu bytes in %llu chunks, "
+           "%llu syscalls (%.2f per chunk).\n",
+           conns, n_workers, bytes, chunks, syscalls, chunks ? (double)syscalls / chunks : 0.0);
+
+    free(workers);
+    return status;
 }
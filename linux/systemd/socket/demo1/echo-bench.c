@@ -0,0 +1,204 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+// 回显服务的本地压测客户端，不依赖 libsystemd：
+//   短连接：每个线程反复 连接 -> 发送一条消息 -> 收齐回显 -> 关闭，统计每秒连接数
+//   长连接：每个线程保持一条连接做 ping-pong，统计每秒请求数与往返延迟
+
+#define DEFAULT_PORT 9999
+#define DEFAULT_CLIENTS 16
+#define DEFAULT_SECONDS 2
+#define DEFAULT_MSG_SIZE 64
+#define MAX_MSG_SIZE 65536
+
+typedef struct {
+    uint64_t *samples;       // 每次操作的耗时（纳秒）
+    size_t count;
+    size_t capacity;
+    unsigned long errors;
+} worker_stats_t;
+
+typedef struct {
+    struct sockaddr_in addr;
+    int persistent;
+    size_t msg_size;
+    uint64_t deadline;
+    worker_stats_t stats;
+} worker_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void record(worker_stats_t *s, uint64_t ns) {
+    if (s->count == s->capacity) {
+        s->capacity = s->capacity ? s->capacity * 2 : 4096;
+        s->samples = realloc(s->samples, sizeof(uint64_t) * s->capacity);
+        if (s->samples == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    s->samples[s->count++] = ns;
+}
+
+static int connect_to(const struct sockaddr_in *addr) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+
+    if (fd == -1) {
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 发送一条消息并收齐同样长度的回显
+static int echo_once(int fd, const char *msg, char *reply, size_t len) {
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t n = send(fd, msg + done, len - done, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) continue;
+            return -1;
+        }
+        done += n;
+    }
+    for (done = 0; done < len;) {
+        ssize_t n = recv(fd, reply + done, len - done, 0);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) continue;
+            return -1;
+        }
+        done += n;
+    }
+    return memcmp(msg, reply, len) == 0 ? 0 : -1;
+}
+
+static void *worker_main(void *arg) {
+    worker_t *w = arg;
+    char *msg = malloc(w->msg_size), *reply = malloc(w->msg_size);
+    int fd = -1;
+
+    for (size_t i = 0; i < w->msg_size; i++) {
+        msg[i] = (char)('a' + i % 26);
+    }
+
+    while (now_ns() < w->deadline) {
+        uint64_t start = now_ns();
+
+        if (fd == -1 && (fd = connect_to(&w->addr)) == -1) {
+            w->stats.errors++;
+            usleep(1000);
+            continue;
+        }
+        if (echo_once(fd, msg, reply, w->msg_size) != 0) {
+            w->stats.errors++;
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        if (!w->persistent) {
+            close(fd);
+            fd = -1;
+        }
+        record(&w->stats, now_ns() - start);
+    }
+    if (fd != -1) {
+        close(fd);
+    }
+    free(msg);
+    free(reply);
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const char *label, const struct sockaddr_in *addr, int clients, int seconds,
+                size_t msg_size, int persistent) {
+    pthread_t *tids = malloc(sizeof(pthread_t) * clients);
+    worker_t *workers = calloc(clients, sizeof(worker_t));
+    uint64_t start = now_ns();
+    size_t total = 0;
+    unsigned long errors = 0;
+
+    for (int i = 0; i < clients; i++) {
+        workers[i].addr = *addr;
+        workers[i].persistent = persistent;
+        workers[i].msg_size = msg_size;
+        workers[i].deadline = start + (uint64_t)seconds * 1000000000ULL;
+        pthread_create(&tids[i], NULL, worker_main, &workers[i]);
+    }
+    for (int i = 0; i < clients; i++) {
+        pthread_join(tids[i], NULL);
+        total += workers[i].stats.count;
+        errors += workers[i].stats.errors;
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    // 合并所有线程的样本求分位数
+    uint64_t *all = malloc(sizeof(uint64_t) * (total ? total : 1));
+    size_t k = 0;
+    for (int i = 0; i < clients; i++) {
+        memcpy(all + k, workers[i].stats.samples, sizeof(uint64_t) * workers[i].stats.count);
+        k += workers[i].stats.count;
+        free(workers[i].stats.samples);
+    }
+    qsort(all, total, sizeof(uint64_t), cmp_u64);
+
+    printf("%-12s %10.0f/s  p50 %8.1f us  p99 %8.1f us  max %8.1f us  errors %lu\n", label,
+           total / elapsed, total ? all[total / 2] / 1e3 : 0.0,
+           total ? all[total * 99 / 100] / 1e3 : 0.0, total ? all[total - 1] / 1e3 : 0.0,
+           errors);
+
+    free(all);
+    free(tids);
+    free(workers);
+}
+
+int main(int argc, char *argv[]) {
+    const char *host = argc > 1 ? argv[1] : "127.0.0.1";
+    int port = argc > 2 ? atoi(argv[2]) : DEFAULT_PORT;
+    int clients = argc > 3 ? atoi(argv[3]) : DEFAULT_CLIENTS;
+    int seconds = argc > 4 ? atoi(argv[4]) : DEFAULT_SECONDS;
+    long msg_size = argc > 5 ? atol(argv[5]) : DEFAULT_MSG_SIZE;
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1 || port <= 0 || clients <= 0 ||
+        seconds <= 0 || msg_size <= 0 || msg_size > MAX_MSG_SIZE) {
+        fprintf(stderr, "Usage: %s [host] [port] [clients] [seconds] [message bytes (1-%d)]\n",
+                argv[0], MAX_MSG_SIZE);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s:%d, %d clients, %d s per run, %ld-byte messages\n", host, port, clients, seconds,
+           msg_size);
+    run("connections", &addr, clients, seconds, msg_size, 0);
+    run("requests", &addr, clients, seconds, msg_size, 1);
+
+    return EXIT_SUCCESS;
+}
@@ -1,18 +1,665 @@
-#include <unistd.h>
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <systemd/sd-daemon.h>
 
-int main() {
-    openlog("echo2", LOG_PID | LOG_CONS, LOG_DAEMON);
-    char buf[1024];
+#define DEFAULT_BUFSIZE (64 * 1024)   // copy 模式的缓冲区 / splice 模式的管道容量
+#define MIN_BUFSIZE 1024
+#define MAX_BUFSIZE (64 * 1024 * 1024)
+#define LEGACY_BUFSIZE 1024           // 原来的 read/write 循环
+#define MAX_POOL_WORKERS 1024
+#define POOL_MIN_SPARE 4              // 进程池至少保持这么多空闲 worker
+#define POOL_MAX_SPARE 16             // 空闲 worker 超过这么多时，多余的退出
+#define POOL_RETRY_SEC 1              // fork 失败的 worker 每隔这么久重试一次
+#define POOL_LONG_MS 100              // 连接处理超过这么久才算占住了 worker
+#define POOL_CHECK_MS 20              // 空闲 worker 不够时父进程检查的间隔
+
+#define BENCH_MAX_BYTES (1ULL << 30)  // 基准测试从 1 KiB 测到 1 GiB
+#define BENCH_STEP 32                 // 每档传输量乘以 32
+#define BENCH_MIN_TOTAL (64ULL << 20) // 传输量小时重复多次，每档至少传这么多
+#define BENCH_MAX_REPS 200
+#define LEGACY_SYSLOG_MAX (1ULL << 20) // 每块都写 syslog 的旧循环只测到 1 MiB，免得刷屏日志
+#define PATTERN_SIZE 65521            // 校验用的数据模式，取素数长度避免与块大小对齐
+
+// 每个连接的统计；日志只记录长度：按 1、2、4、8... 块采样，结束时再汇总一条
+typedef struct {
+    unsigned long long bytes;
+    unsigned long chunks;
+    int log;
+} echo_stats_t;
+
+static void log_chunk(echo_stats_t *st, ssize_t n) {
+    st->bytes += n;
+    st->chunks++;
+    if (st->log && (st->chunks & (st->chunks - 1)) == 0) {
+        syslog(LOG_INFO, "chunk %lu: %zd bytes (%llu total)", st->chunks, n, st->bytes);
+    }
+}
+
+static int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// 原来的循环：1 KiB 缓冲区，每块把内容当字符串写进 syslog，只保留下来做基准对比。
+// 读 sizeof(buf) - 1 字节，给结尾的 '\0' 留位置（原代码读满 1024 字节时会越界）
+static int echo_legacy(int in, int out, echo_stats_t *st) {
+    char buf[LEGACY_BUFSIZE];
     ssize_t n;
 
-    // 直接从 stdin 读，写到 stdout
-    while ((n = read(STDIN_FILENO, buf, sizeof(buf))) > 0) {
+    while ((n = read(in, buf, sizeof(buf) - 1)) > 0) {
         buf[n] = '\0';
-        write(STDOUT_FILENO, buf, n);
-        syslog(LOG_INFO, "Received: %s", buf);
+        if (write_all(out, buf, n) != 0) {
+            return -1;
+        }
+        st->bytes += n;
+        st->chunks++;
+        if (st->log) {
+            syslog(LOG_INFO, "Received: %s", buf);
+        }
     }
+    return n == 0 ? 0 : -1;
+}
 
-    // 处理完自动退出
+// 普通的 read/write 回显，缓冲区大小可配置
+static int echo_copy(int in, int out, size_t bufsize, echo_stats_t *st) {
+    char *buf = malloc(bufsize);
+    ssize_t n;
+    int ret = 0;
+
+    if (buf == NULL) {
+        return -1;
+    }
+    for (;;) {
+        n = read(in, buf, bufsize);
+        if (n == 0) {
+            break;
+        }
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            ret = -1;
+            break;
+        }
+        if (write_all(out, buf, n) != 0) {
+            ret = -1;
+            break;
+        }
+        log_chunk(st, n);
+    }
+    free(buf);
+    return ret;
+}
+
+// 零拷贝回显：stdin -> 管道 -> stdout 全程 splice，数据只在内核的页之间移动，不经过用户态缓冲区。
+// 返回 0 表示对端关闭，-1 表示出错；返回 1 表示这一对 fd 不支持 splice（例如在终端上手动运行），
+// 此时管道里已收到的数据已经写出，调用方接着用 copy 模式
+static int echo_splice(int in, int out, size_t bufsize, echo_stats_t *st) {
+    int p[2];
+    int ret = 0;
+
+    if (pipe2(p, O_CLOEXEC) == -1) {
+        return 1;
+    }
+    // 管道容量决定一次 splice 最多搬多少数据；非特权进程上限为 /proc/sys/fs/pipe-max-size，失败就用默认的 64 KiB
+    fcntl(p[1], F_SETPIPE_SZ, (int)bufsize);
+
+    for (;;) {
+        ssize_t n = splice(in, NULL, p[1], NULL, bufsize, SPLICE_F_MOVE);
+        if (n == 0) {
+            break;
+        }
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            ret = errno == EINVAL && st->chunks == 0 ? 1 : -1;
+            break;
+        }
+
+        // 把管道里这一批数据全部送到 stdout
+        size_t left = n;
+        while (left > 0) {
+            ssize_t m = splice(p[0], NULL, out, NULL, left, SPLICE_F_MOVE);
+            if (m == -1 && errno == EINTR) {
+                continue;
+            }
+            if (m == -1 && errno == EINVAL) {
+                // 输出端不支持 splice：把管道里剩下的数据读出来写掉，再整体退回 copy 模式
+                char buf[4096];
+                while (left > 0) {
+                    ssize_t r = read(p[0], buf, left < sizeof(buf) ? left : sizeof(buf));
+                    if (r <= 0 || write_all(out, buf, r) != 0) {
+                        break;
+                    }
+                    left -= r;
+                }
+                ret = left == 0 ? 1 : -1;
+                break;
+            }
+            if (m <= 0) {
+                ret = -1;
+                break;
+            }
+            left -= m;
+        }
+        if (ret != 0) {
+            break;
+        }
+        log_chunk(st, n);
+    }
+    close(p[0]);
+    close(p[1]);
+    return ret;
+}
+
+// 处理一个连接：连接就是 stdin/stdout，mode 为 auto/splice/copy，结束时汇总记一条日志
+static int echo_stdio(const char *mode, size_t bufsize) {
+    echo_stats_t st = {0, 0, 1};
+    const char *used = "copy";
+    int ret = 1;
+
+    // 直接从 stdin 读，写到 stdout
+    if (strcmp(mode, "copy") != 0) {
+        ret = echo_splice(STDIN_FILENO, STDOUT_FILENO, bufsize, &st);
+        used = "splice";
+        if (ret == 1 && strcmp(mode, "splice") == 0) {
+            syslog(LOG_WARNING, "splice not supported on these fds, using copy");
+        }
+    }
+    if (ret == 1) {
+        ret = echo_copy(STDIN_FILENO, STDOUT_FILENO, bufsize, &st);
+        used = "copy";
+    }
+
+    syslog(LOG_INFO, "Echoed %llu bytes in %lu chunks via %s", st.bytes, st.chunks, used);
+    return ret == 0 ? 0 : -1;
+}
+
+/* ---------------- 常驻预派生进程池（Accept=false） ---------------- */
+
+// Accept=true 时 systemd 为每个连接 fork+exec 一个 echo2，连接速率高时进程创建和 openlog 的开销占了大头。
+// 池模式下 systemd 只启动一次 echo2 并传入监听 socket（fd 3），父进程预先 fork 出若干 worker，
+// 每个 worker 循环 accept，把连接 dup2 到 stdin/stdout 后调用与 Accept=true 完全相同的 echo_stdio。
+// 每个 worker 同一时刻只服务一个连接，所以池按需伸缩：worker 在共享的记分板上登记自己空闲还是忙，
+// 空闲的少于 POOL_MIN_SPARE 时通知父进程，父进程每 POOL_CHECK_MS 检查一次，把被长连接（忙了超过
+// POOL_LONG_MS）占住的 worker 补上。刚接收的短连接不算：CPU 饱和时 worker 要排队才能读到 EOF，
+// 按忙的个数 fork 只会让排队更长，池越 fork 越大。
+// 空闲的多于 POOL_MAX_SPARE 时父进程每 POOL_RETRY_SEC 秒批准一个 worker 退出，由下一个处理完连接的
+// worker 领取，避免并发数在两个阈值之间波动时不停地 fork 和退出
+
+enum { SLOT_EMPTY, SLOT_IDLE, SLOT_BUSY };
+
+typedef struct {
+    int retire;                            // 父进程批准退出的名额，0 或 1
+    unsigned char slots[MAX_POOL_WORKERS]; // 下标与父进程的 pids[] 一致
+    unsigned busy_since[MAX_POOL_WORKERS]; // 开始处理当前连接的时刻（毫秒）
+} pool_board_t;
+
+static pool_board_t *pool_board;  // MAP_SHARED，父进程和所有 worker 共用
+
+static int pool_count(int state) {
+    int n = 0;
+    for (int i = 0; i < MAX_POOL_WORKERS; i++) {
+        n += __atomic_load_n(&pool_board->slots[i], __ATOMIC_RELAXED) == state;
+    }
+    return n;
+}
+
+static void pool_set(int slot, int state) {
+    __atomic_store_n(&pool_board->slots[slot], state, __ATOMIC_RELAXED);
+}
+
+static unsigned pool_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+// 能接新连接的 worker：空闲的，加上连接开始不久、多半很快就会结束的
+static int pool_spare(void) {
+    unsigned now = pool_now_ms();
+    int n = 0;
+    for (int i = 0; i < MAX_POOL_WORKERS; i++) {
+        int state = __atomic_load_n(&pool_board->slots[i], __ATOMIC_RELAXED);
+        n += state == SLOT_IDLE ||
+             (state == SLOT_BUSY &&
+              now - __atomic_load_n(&pool_board->busy_since[i], __ATOMIC_RELAXED) < POOL_LONG_MS);
+    }
+    return n;
+}
+
+static void pool_worker(int listen_fd, const char *mode, size_t bufsize, int slot, pid_t parent) {
+    int devnull = open("/dev/null", O_RDWR | O_CLOEXEC);
+
+    openlog("echo2", LOG_PID | LOG_CONS, LOG_DAEMON);
+    for (;;) {
+        // 多个进程阻塞在同一个 socket 的 accept 上，内核每个连接只唤醒其中一个
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            syslog(LOG_ERR, "accept: %m");
+            sleep(1);  // 例如 EMFILE，稍后再试
+            continue;
+        }
+        __atomic_store_n(&pool_board->busy_since[slot], pool_now_ms(), __ATOMIC_RELAXED);
+        pool_set(slot, SLOT_BUSY);
+        if (pool_count(SLOT_IDLE) < POOL_MIN_SPARE) {
+            kill(parent, SIGUSR1);
+        }
+        dup2(fd, STDIN_FILENO);
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+
+        echo_stdio(mode, bufsize);
+
+        // 用 /dev/null 顶替 stdin/stdout，既关闭了连接，又保证 0、1 号 fd 一直被占用
+        dup2(devnull, STDIN_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+
+        if (__atomic_exchange_n(&pool_board->retire, 0, __ATOMIC_RELAXED)) {
+            pool_set(slot, SLOT_EMPTY);
+            return;  // 高峰过去，多余的 worker 退出
+        }
+        pool_set(slot, SLOT_IDLE);
+    }
+}
+
+static pid_t pool_spawn(int listen_fd, const char *mode, size_t bufsize, int slot,
+                        const sigset_t *orig) {
+    pid_t parent = getpid();
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        // 恢复父进程屏蔽前的信号掩码，SIGTERM 按默认动作直接结束 worker
+        sigprocmask(SIG_SETMASK, orig, NULL);
+        pool_worker(listen_fd, mode, bufsize, slot, parent);
+        _exit(0);
+    }
+    if (pid == -1) {
+        syslog(LOG_ERR, "fork: %m");  // 例如 EAGAIN（达到 RLIMIT_NPROC），稍后重试
+    }
+    return pid;
+}
+
+static int pool_live(const pid_t *pids) {
+    int live = 0;
+    for (int i = 0; i < MAX_POOL_WORKERS; i++) {
+        live += pids[i] > 0;
+    }
+    return live;
+}
+
+// fork 到至少 min_workers 个 worker，且至少 POOL_MIN_SPARE 个能接新连接，总数不超过 MAX_POOL_WORKERS
+static void pool_fill(pid_t *pids, int min_workers, int listen_fd, const char *mode, size_t bufsize,
+                      const sigset_t *orig) {
+    int live = pool_live(pids);
+    int spare = pool_spare();
+
+    for (int i = 0; i < MAX_POOL_WORKERS && (live < min_workers || spare < POOL_MIN_SPARE); i++) {
+        if (pids[i] > 0) {
+            continue;  // 包括已登记退出、还没被 waitpid 回收的 worker
+        }
+        pool_set(i, SLOT_IDLE);
+        pids[i] = pool_spawn(listen_fd, mode, bufsize, i, orig);
+        if (pids[i] == -1) {
+            pids[i] = 0;
+            pool_set(i, SLOT_EMPTY);
+            return;  // 再 fork 多半也是同样的错误
+        }
+        live++;
+        spare++;
+    }
+}
+
+static int run_pool(int min_workers, const char *mode, size_t bufsize) {
+    int n_fds = sd_listen_fds(0);
+    if (n_fds <= 0) {
+        fprintf(stderr, "Not started by systemd socket activation.\n");
+        return 1;
+    }
+    int listen_fd = SD_LISTEN_FDS_START;
+    pid_t *pids = calloc(MAX_POOL_WORKERS, sizeof(pid_t));
+    if (pids == NULL) {
+        perror("calloc");
+        return 1;
+    }
+    pool_board = mmap(NULL, sizeof(pool_board_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                      -1, 0);
+    if (pool_board == MAP_FAILED) {
+        perror("mmap");
+        free(pids);
+        return 1;
+    }
+
+    // 父进程只用 sigtimedwait 同步处理信号：SIGTERM/SIGINT 停止，SIGCHLD 回收退出的 worker，
+    // SIGUSR1 表示空闲 worker 不够了；每次醒来（包括超时，用来重试失败的 fork）都把池补足。
+    // 空闲的不够时每 POOL_CHECK_MS 醒来一次，等忙着的连接变成长连接时及时补上
+    sigset_t set, orig;
+    sigemptyset(&set);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGCHLD);
+    sigaddset(&set, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &set, &orig);
+
+    openlog("echo2", LOG_PID | LOG_CONS, LOG_DAEMON);
+    pool_fill(pids, min_workers, listen_fd, mode, bufsize, &orig);
+    syslog(LOG_INFO, "Pool of %d-%d workers (%d-%d spare) accepting on fd %d (%s, %zu-byte buffer)",
+           min_workers, MAX_POOL_WORKERS, POOL_MIN_SPARE, POOL_MAX_SPARE, listen_fd, mode, bufsize);
+
+    const struct timespec retry = { .tv_sec = POOL_RETRY_SEC };
+    const struct timespec check = { .tv_nsec = POOL_CHECK_MS * 1000000L };
+    struct timespec last_tick, now;
+    clock_gettime(CLOCK_MONOTONIC, &last_tick);
+    for (;;) {
+        int short_of_idle =
+            pool_count(SLOT_IDLE) < POOL_MIN_SPARE && pool_live(pids) < MAX_POOL_WORKERS;
+        int sig = sigtimedwait(&set, NULL, short_of_idle ? &check : &retry);
+        if (sig == SIGTERM || sig == SIGINT) {
+            break;
+        }
+        pid_t pid;
+        int wstatus;
+        while ((pid = waitpid(-1, &wstatus, WNOHANG)) > 0) {
+            for (int i = 0; i < MAX_POOL_WORKERS; i++) {
+                if (pids[i] == pid) {
+                    if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+                        syslog(LOG_WARNING, "Worker %d exited (status 0x%x), respawning", pid,
+                               wstatus);
+                    }
+                    pids[i] = 0;
+                    pool_set(i, SLOT_EMPTY);
+                }
+            }
+        }
+        pool_fill(pids, min_workers, listen_fd, mode, bufsize, &orig);
+
+        // 负载高时 SIGUSR1/SIGCHLD 不断到来，sigtimedwait 不会超时，所以按实际经过的时间批准退出
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec - last_tick.tv_sec >= POOL_RETRY_SEC) {
+            last_tick = now;
+            int excess = pool_count(SLOT_IDLE) > POOL_MAX_SPARE && pool_live(pids) > min_workers;
+            __atomic_store_n(&pool_board->retire, excess, __ATOMIC_RELAXED);
+        }
+    }
+
+    for (int i = 0; i < MAX_POOL_WORKERS; i++) {
+        if (pids[i] > 0) {
+            kill(pids[i], SIGTERM);
+        }
+    }
+    while (wait(NULL) > 0) {
+    }
+    syslog(LOG_INFO, "Pool stopped");
+    closelog();
+    munmap(pool_board, sizeof(pool_board_t));
+    free(pids);
     return 0;
 }
+
+/* ---------------- 基准测试 ---------------- */
+
+// 把一条回环 TCP 连接交给 fork 出来的子进程回显，就像 systemd 把连接作为 stdin/stdout 交给 echo2；
+// 父进程一个线程发送、主线程接收并校验，计时从开始发送到收齐全部回显
+enum { MODE_LEGACY_SYSLOG, MODE_LEGACY, MODE_COPY, MODE_SPLICE, MODE_COUNT };
+
+static const char *const mode_names[MODE_COUNT] = {
+    "1KiB+syslog", "1KiB loop", "copy", "splice"
+};
+
+static unsigned char pattern[PATTERN_SIZE * 2];
+
+typedef struct {
+    int fd;
+    unsigned long long bytes;
+} sender_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *sender_main(void *arg) {
+    sender_t *s = arg;
+    unsigned long long sent = 0;
+
+    while (sent < s->bytes) {
+        size_t off = sent % PATTERN_SIZE;
+        size_t len = s->bytes - sent < PATTERN_SIZE ? s->bytes - sent : PATTERN_SIZE;
+        ssize_t n = send(s->fd, pattern + off, len, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        sent += n;
+    }
+    shutdown(s->fd, SHUT_WR);
+    return NULL;
+}
+
+static int tcp_pair(int listen_fd, const struct sockaddr_in *addr, int *client, int *server) {
+    *client = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (*client == -1 || connect(*client, (const struct sockaddr *)addr, sizeof(*addr)) == -1) {
+        return -1;
+    }
+    *server = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    return *server == -1 ? -1 : 0;
+}
+
+// 一次完整的传输，返回耗时（秒），出错或数据不一致返回 -1
+static double bench_once(int listen_fd, const struct sockaddr_in *addr, int mode, size_t bufsize,
+                         unsigned long long bytes) {
+    static char rbuf[1 << 20];
+    int client, server;
+
+    if (tcp_pair(listen_fd, addr, &client, &server) != 0) {
+        perror("connect");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        echo_stats_t st = {0, 0, mode == MODE_LEGACY_SYSLOG};
+        int ret;
+
+        close(client);
+        switch (mode) {
+        case MODE_LEGACY_SYSLOG:
+        case MODE_LEGACY:
+            ret = echo_legacy(server, server, &st);
+            break;
+        case MODE_COPY:
+            ret = echo_copy(server, server, bufsize, &st);
+            break;
+        default:
+            ret = echo_splice(server, server, bufsize, &st);
+            break;
+        }
+        _exit(ret == 0 ? 0 : 1);
+    }
+    close(server);
+    if (pid == -1) {
+        close(client);
+        return -1;
+    }
+
+    double start = now_sec();
+    sender_t s = {client, bytes};
+    pthread_t tid;
+    pthread_create(&tid, NULL, sender_main, &s);
+
+    unsigned long long got = 0;
+    int ok = 1;
+    for (;;) {
+        ssize_t n = recv(client, rbuf, sizeof(rbuf), 0);
+        if (n == 0) {
+            break;
+        }
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            ok = 0;
+            break;
+        }
+        // 按发送方的模式逐段校验，二进制数据（含 '\0'）必须原样回来
+        for (ssize_t i = 0; i < n && ok;) {
+            size_t off = (got + i) % PATTERN_SIZE;
+            size_t len = n - i < PATTERN_SIZE ? n - i : PATTERN_SIZE;
+            ok = memcmp(rbuf + i, pattern + off, len) == 0;
+            i += len;
+        }
+        got += n;
+    }
+    double elapsed = now_sec() - start;
+
+    pthread_join(tid, NULL);
+    close(client);
+    int wstatus;
+    waitpid(pid, &wstatus, 0);
+    if (!ok || got != bytes || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+        return -1;
+    }
+    return elapsed;
+}
+
+static void format_size(unsigned long long bytes, char *out, size_t len) {
+    if (bytes >= 1ULL << 30) {
+        snprintf(out, len, "%llu GiB", bytes >> 30);
+    } else if (bytes >= 1ULL << 20) {
+        snprintf(out, len, "%llu MiB", bytes >> 20);
+    } else {
+        snprintf(out, len, "%llu KiB", bytes >> 10);
+    }
+}
+
+static int bench(unsigned long long max_bytes, size_t bufsize) {
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (listen_fd == -1 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(listen_fd, 16) == -1 ||
+        getsockname(listen_fd, (struct sockaddr *)&addr, &addrlen) == -1) {
+        perror("listen");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < sizeof(pattern); i++) {
+        pattern[i] = (unsigned char)((i % PATTERN_SIZE) * 131 + 7);
+    }
+    openlog("echo2-bench", LOG_PID, LOG_DAEMON);
+
+    printf("回环 TCP，copy/splice 缓冲区 %zu 字节，单位: MiB/s（%s 只测到 %llu MiB）\n", bufsize,
+           mode_names[MODE_LEGACY_SYSLOG], LEGACY_SYSLOG_MAX >> 20);
+    printf("%-10s", "传输量");
+    for (int m = 0; m < MODE_COUNT; m++) {
+        printf(" %12s", mode_names[m]);
+    }
+    printf("\n");
+
+    for (unsigned long long bytes = 1024; bytes <= max_bytes; bytes *= BENCH_STEP) {
+        unsigned long long reps = BENCH_MIN_TOTAL / bytes;
+        char label[32];
+
+        reps = reps < 1 ? 1 : reps > BENCH_MAX_REPS ? BENCH_MAX_REPS : reps;
+        format_size(bytes, label, sizeof(label));
+        printf("%-10s", label);
+        for (int m = 0; m < MODE_COUNT; m++) {
+            double total = 0;
+
+            if (m == MODE_LEGACY_SYSLOG && bytes > LEGACY_SYSLOG_MAX) {
+                printf(" %12s", "-");
+                continue;
+            }
+            for (unsigned long long r = 0; r < reps && total >= 0; r++) {
+                double t = bench_once(listen_fd, &addr, m, bufsize, bytes);
+                total = t < 0 ? -1 : total + t;
+            }
+            if (total < 0) {
+                printf(" %12s", "失败");
+            } else {
+                printf(" %12.1f", bytes * reps / total / (1 << 20));
+            }
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+
+    closelog();
+    close(listen_fd);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    // echo2 [auto|splice|copy] [缓冲区字节数]：auto（默认）优先 splice，fd 不支持时退回 copy
+    // echo2 pool [最少 worker 数] [auto|splice|copy] [缓冲区字节数]：Accept=false 的常驻进程池，
+    // 按需增长到 MAX_POOL_WORKERS，0 表示每个 CPU 一个
+    // echo2 bench [最大传输字节数] [缓冲区字节数]
+    const char *cmd = argc > 1 ? argv[1] : "auto";
+    int is_bench = strcmp(cmd, "bench") == 0;
+    int is_pool = strcmp(cmd, "pool") == 0;
+    const char *mode = cmd;
+    unsigned long long max_bytes = BENCH_MAX_BYTES;
+    long bufsize = DEFAULT_BUFSIZE;
+    int workers = 0;
+
+    if (is_bench) {
+        max_bytes = argc > 2 ? strtoull(argv[2], NULL, 0) : BENCH_MAX_BYTES;
+        bufsize = argc > 3 ? atol(argv[3]) : DEFAULT_BUFSIZE;
+        mode = "auto";
+    } else if (is_pool) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = argc > 2 ? atoi(argv[2]) : 0;
+        if (workers == 0) {
+            workers = cpus > 0 ? (int)cpus : 1;
+        }
+        mode = argc > 3 ? argv[3] : "auto";
+        bufsize = argc > 4 ? atol(argv[4]) : DEFAULT_BUFSIZE;
+    } else if (argc > 2) {
+        bufsize = atol(argv[2]);
+    }
+    if ((strcmp(mode, "auto") != 0 && strcmp(mode, "splice") != 0 && strcmp(mode, "copy") != 0) ||
+        bufsize < MIN_BUFSIZE || bufsize > MAX_BUFSIZE || max_bytes < 1024 || workers < 0 ||
+        workers > MAX_POOL_WORKERS) {
+        fprintf(stderr,
+                "用法: %s [auto|splice|copy] [缓冲区字节数(%d-%d)]\n"
+                "      %s pool [最少 worker 数(0 = 每个 CPU 一个)] [auto|splice|copy] [缓冲区字节数]\n"
+                "      %s bench [最大传输字节数] [缓冲区字节数]\n",
+                argv[0], MIN_BUFSIZE, MAX_BUFSIZE, argv[0], argv[0]);
+        return 1;
+    }
+    if (is_bench) {
+        return bench(max_bytes, bufsize);
+    }
+    if (is_pool) {
+        return run_pool(workers, mode, bufsize);
+    }
+
+    openlog("echo2", LOG_PID | LOG_CONS, LOG_DAEMON);
+    int ret = echo_stdio(mode, bufsize);
+    closelog();
+
+    // 处理完自动退出
+    return ret == 0 ? 0 : 1;
+}